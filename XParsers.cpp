@@ -28,6 +28,58 @@
  *
  * Modification Notes:
  * --------------------
+ * 10/17/2026 AG
+ *   loadElementById now looks names up in a hash table of the ID
+ *   attributes of the document, built once right after the parse, and
+ *   the translators use it everywhere in place of getElementById.
+ *   Elements stitched in later by the lazy loader are added to the table
+ *   the first time they are looked up.
+ *
+ * 10/17/2026 AG
+ *   Added a lazy loading mode (see setLazyLoading) in which the included
+ *   detector files of a previously validated document are only parsed
+ *   when loadElementById asks for an element that one of them defines.
+ *   mayReference tells from an index of the raw text which elements can
+ *   lead to a given one, so that a search can skip the rest unparsed.
+ *
+ * 10/17/2026 AG
+ *   A document that passed validation before and includes its detector
+ *   files as external entities is now parsed in pieces on several threads
+ *   (see setParseThreads) and the pieces are joined into the same tree
+ *   that a parse in one piece would give.
+ *
+ * 10/17/2026 AG
+ *   MyEntityResolver now reads each file of the document once and keeps
+ *   the contents in memory.  Xerces gets them through MemBufInputSource,
+ *   and the MD5 checksum, the validation record check and the schema
+ *   lookup all work from the same bytes instead of reopening the files.
+ *
+ * 10/17/2026 AG
+ *   Each document now keeps a validation record of the checksums that
+ *   passed validation, together with the version (MD5 checksum) of the
+ *   schema they were checked against.  A document whose present checksum
+ *   is found in the record is parsed with validation turned off.
+ *
+ * 10/17/2026 AG
+ *   All parsers now share one grammar pool.  The first validating parse
+ *   of a document compiles its schema into the pool and serializes the
+ *   pool to a grammar file next to the schema (or in $HDDS_CACHE_DIR),
+ *   and later runs deserialize the compiled grammar from there instead
+ *   of parsing and checking the schema again.  The grammar file records
+ *   the MD5 checksum of the schema it was made from, so an edited schema
+ *   is recompiled automatically; setGrammarRebuild(true) forces this.
+ *   Because xerces does not open the schema when it comes from the pool,
+ *   the schema is put back into the list of files behind the MD5 sum at
+ *   the position it had when the grammar was compiled.
+ *
+ * 10/17/2026 AG
+ *   Split the checksum arithmetic out of MyEntityResolver into the free
+ *   function computeMD5checksum() so that a stored list of xml files can
+ *   be re-verified without running the parser, and record the list of
+ *   files behind last_md5_checksum in last_md5_filenames.  Added
+ *   releaseInputDocument() so that callers that have extracted what
+ *   they need from the scratch document can give its memory back.
+ *
  * 11/7/2012 DL
  *   Added EntityResolver class to keep track of all of the XML files
  *   pulled in by the parser so an md5 checksum could be performed.
@@ -48,17 +100,30 @@
  */
 
 #include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
 using namespace std;
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
 #include <xercesc/sax/SAXParseException.hpp>
 #include <xercesc/parsers/XercesDOMParser.hpp>
 #include <xercesc/framework/LocalFileFormatTarget.hpp>
+#include <xercesc/framework/XMLGrammarPoolImpl.hpp>
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/util/BinFileInputStream.hpp>
+#include <xercesc/util/BinFileOutputStream.hpp>
 
 #include "XParsers.hpp"
 #include "XString.hpp"
 #include "md5.h"
 
 std::string last_md5_checksum = "";
+std::vector<std::string> last_md5_filenames;
 
 /*
  * FIX_XERCES_getElementById_BUG does a store/load cycle at parsing time
@@ -67,41 +132,1288 @@ std::string last_md5_checksum = "";
  */
 #define FIX_XERCES_getElementById_BUG true
 
-#define X(str) XString(str).unicode_str()
+#define X(str) XName(str)
 #define S(str) str.c_str()
 
+/*
+ * The serialized grammar file starts with a fixed-size text header
+ * holding GRAMMAR_MAGIC, the MD5 checksum of the schema it was compiled
+ * from and the position of the schema in the list of files behind the
+ * document checksum, followed by the output of serializeGrammars().
+ */
+#define GRAMMAR_MAGIC "HDDSgrammar-1"
+#define GRAMMAR_HEADER_SIZE 64
+
+/*
+ * The validation record of a document keeps the most recent
+ * VALIDATION_RECORD_SIZE (checksum, schema version) pairs that passed
+ * validation, each followed by the list of files behind the checksum.
+ */
+#define VALIDATION_RECORD_SIZE 16
+
+struct ValidationEntry
+{
+   std::string checksum;
+   std::string schema;
+   std::vector<std::string> files;
+};
+
+/*
+ * A previously validated document that includes its detector files as
+ * external entities is parsed in pieces: the top-level document with each
+ * entity reference replaced by a FRAGMENT_MARK processing instruction,
+ * and every included file as a fragment of its own, concurrently on up
+ * to parseThreads threads.  The fragments are then copied into the
+ * top-level document in place of the marks.
+ */
+#define FRAGMENT_MARK "hdds-entity"
+
+struct FragmentJob
+{
+   std::string fname;			// file behind the entity
+   std::string text;			// fragment wrapped in the root element
+   xercesc::XercesDOMParser* parser;	// owns the fragment document
+   bool failed;
+   bool deferred;			// left for lazy loading
+};
+
+class FragmentList : public std::vector<FragmentJob>
+{
+ public:
+   ~FragmentList();
+};
+
+FragmentList::~FragmentList()
+{
+   for (unsigned int i = 0; i < size(); i++)
+   {
+      delete (*this)[i].parser;
+   }
+}
+
+struct FragmentQueue
+{
+   FragmentList* jobs;
+   std::vector<unsigned int> order;	// largest fragment first
+   unsigned int next;
+   pthread_mutex_t mutex;
+};
+
+/*
+ * In lazy loading mode only the fragments that hold the materials and
+ * the regions are parsed up front, the others are parsed and stitched in
+ * the first time one of their elements is asked for by loadElementById.
+ * To know where to look, the raw text of every file is indexed for the
+ * elements named by a LAZY_ID_ATTRIBUTE attribute and for the values of
+ * the other attributes found inside them, which includes every IDREF.
+ * The same index answers mayReference without parsing anything.
+ */
+#define LAZY_ID_ATTRIBUTE "name"
+
+struct LazyDocument
+{
+   FragmentList fragments;
+   std::vector<xercesc::DOMNode*> marks;  // where each fragment goes
+   std::map<std::string,int> definedIn;	  // fragment of each id, -1 for
+					  // the top-level document
+   std::map<std::string,std::vector<std::string> > references;
+   std::string target;			  // last target of mayReference
+   std::set<std::string> reachers;	  // ids that may reference target
+};
+
+static std::map<const xercesc::DOMDocument*,LazyDocument*> lazyDocuments;
+
+static xercesc::XercesDOMParser* scratchParser=0;
+static xercesc::XMLGrammarPool* grammarPool=0;
+static std::string grammarSchema;	// schema held in grammarPool
+static int grammarPosition=-1;		// its place among the md5 files
+static bool grammarRebuild=false;
+static int parseThreads=0;		// 0 means one per cpu
+static bool lazyLoading=false;
+
+void setGrammarRebuild(bool rebuild)
+{
+   grammarRebuild = rebuild;
+}
+
+void setParseThreads(int nthreads)
+{
+   parseThreads = nthreads;
+}
+
+void setLazyLoading(bool lazy)
+{
+   lazyLoading = lazy;
+}
+
+static int parseThreadCount()
+{
+   if (parseThreads > 0)
+   {
+      return parseThreads;
+   }
+   long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+   return (ncpu > 0)? ncpu : 1;
+}
+
+// Returns the schema file named in the xsi:schemaLocation (or
+// xsi:noNamespaceSchemaLocation) attribute of the document element,
+// with the same path prefix that MyEntityResolver gives it.
+
+static std::string findSchemaFile(MyEntityResolver& resolver,
+                                  const XString& xmlFile)
+{
+   const std::string* contents = resolver.GetXMLFile(xmlFile);
+   if (contents == 0)
+   {
+      return "";
+   }
+   const std::string& text = *contents;
+   size_t pos = text.find("schemaLocation");
+   if (pos == std::string::npos)
+   {
+      return "";
+   }
+   size_t open = text.find_first_of("\"'", pos);
+   size_t close = (open == std::string::npos)? open :
+                  text.find_first_of("\"'", open + 1);
+   if (close == std::string::npos)
+   {
+      return "";
+   }
+   std::istringstream value(text.substr(open + 1, close - open - 1));
+   std::string location;
+   std::string token;
+   while (value >> token)
+   {
+      location = token;
+   }
+   if (location.size() == 0)
+   {
+      return "";
+   }
+   std::string fname = xmlFile;
+   size_t slash = fname.find_last_of('/');
+   std::string path = (slash != std::string::npos)?
+                      fname.substr(0,slash) + "/" : "";
+   return path + location;
+}
+
+// Returns the name of the hidden file .<file>.<suffix> that keeps
+// derived information about file, placed in the same directory unless
+// HDDS_CACHE_DIR says otherwise (HDDS_CACHE_DIR=none turns them off).
+
+static std::string cacheFile(const std::string& file,
+                             const std::string& suffix)
+{
+   std::string dir;
+   std::string base = file;
+   size_t slash = file.find_last_of('/');
+   if (slash != std::string::npos)
+   {
+      dir = file.substr(0,slash) + "/";
+      base = file.substr(slash + 1);
+   }
+   const char* dirEnv = getenv("HDDS_CACHE_DIR");
+   if (dirEnv != 0)
+   {
+      if (std::string(dirEnv) == "none")
+      {
+         return "";
+      }
+      dir = std::string(dirEnv) + "/";
+   }
+   return dir + "." + base + "." + suffix;
+}
+
+// The schema version is the MD5 checksum of the schema file, so any
+// edit to the schema counts as a new version.
+
+static std::string schemaVersion(MyEntityResolver& resolver,
+                                 const std::string& schemaFile)
+{
+   if (schemaFile.size() == 0)
+   {
+      return "none";
+   }
+   std::vector<std::string> schemaFiles(1, schemaFile);
+   return resolver.ComputeMD5_checksum(schemaFiles);
+}
+
+// Fills the empty grammar pool from the serialized grammar of schemaFile,
+// returns false if there is none or it does not match the schema.
+
+static bool loadGrammar(const std::string& schemaFile,
+                        const std::string& checksum)
+{
+   std::string gfile = cacheFile(schemaFile, "grammar");
+   if (grammarRebuild || gfile.size() == 0)
+   {
+      return false;
+   }
+   try
+   {
+      xercesc::BinFileInputStream ins(gfile.c_str());
+      if (!ins.getIsOpen())
+      {
+         return false;
+      }
+      char header[GRAMMAR_HEADER_SIZE + 1];
+      if (ins.readBytes((XMLByte*)header, GRAMMAR_HEADER_SIZE)
+          != GRAMMAR_HEADER_SIZE)
+      {
+         return false;
+      }
+      header[GRAMMAR_HEADER_SIZE] = 0;
+      char magic[GRAMMAR_HEADER_SIZE];
+      char md5sum[GRAMMAR_HEADER_SIZE];
+      int position;
+      if (sscanf(header, "%s %s %d", magic, md5sum, &position) != 3 ||
+          std::string(magic) != GRAMMAR_MAGIC || checksum != md5sum)
+      {
+         return false;
+      }
+      grammarPool->deserializeGrammars(&ins);
+      grammarPosition = position;
+   }
+   catch (...)
+   {
+      // typically a grammar written by a different version of xerces,
+      // start over with an empty pool and compile the schema again
+      delete grammarPool;
+      grammarPool = new xercesc::XMLGrammarPoolImpl(
+                        xercesc::XMLPlatformUtils::fgMemoryManager);
+      return false;
+   }
+   return true;
+}
+
+// Writes the grammar pool out to the grammar file of schemaFile,
+// failures are silently ignored since the grammar is only an aid.
+
+static void saveGrammar(const std::string& schemaFile,
+                        const std::string& checksum, int position)
+{
+   std::string gfile = cacheFile(schemaFile, "grammar");
+   if (gfile.size() == 0)
+   {
+      return;
+   }
+   char header[GRAMMAR_HEADER_SIZE + 1];
+   memset(header, ' ', GRAMMAR_HEADER_SIZE);
+   int len = sprintf(header, "%s %s %d", GRAMMAR_MAGIC,
+                     checksum.c_str(), position);
+   header[len] = ' ';
+   header[GRAMMAR_HEADER_SIZE - 1] = '\n';
+
+   std::ostringstream tmpfile;
+   tmpfile << gfile << ".tmp" << getpid();
+   bool written = false;
+   try
+   {
+      xercesc::BinFileOutputStream outs(tmpfile.str().c_str());
+      if (outs.getIsOpen())
+      {
+         outs.writeBytes((const XMLByte*)header, GRAMMAR_HEADER_SIZE);
+         grammarPool->lockPool();
+         grammarPool->serializeGrammars(&outs);
+         grammarPool->unlockPool();
+         written = true;
+      }
+   }
+   catch (...)
+   {
+      grammarPool->unlockPool();
+   }
+   if (!written || rename(tmpfile.str().c_str(), gfile.c_str()) != 0)
+   {
+      remove(tmpfile.str().c_str());
+   }
+}
+
+static std::vector<ValidationEntry> readValidationRecord(
+                                    const std::string& rfile)
+{
+   std::vector<ValidationEntry> record;
+   ifstream ifs(rfile.c_str());
+   ValidationEntry entry;
+   unsigned int nfiles;
+   std::string line;
+   while (ifs >> entry.checksum >> entry.schema >> nfiles &&
+          std::getline(ifs, line))
+   {
+      entry.files.clear();
+      while (entry.files.size() < nfiles && std::getline(ifs, line))
+      {
+         entry.files.push_back(line);
+      }
+      if (entry.files.size() < nfiles)
+      {
+         break;
+      }
+      record.push_back(entry);
+   }
+   return record;
+}
+
+// Returns true if the present contents of xmlFile and of the files it
+// includes have already passed validation against this schema version.
+
+static bool wasValidated(MyEntityResolver& resolver,
+                         const XString& xmlFile, const std::string& version)
+{
+   std::string rfile = cacheFile(xmlFile, "validated");
+   if (rfile.size() == 0)
+   {
+      return false;
+   }
+   std::vector<ValidationEntry> record = readValidationRecord(rfile);
+   std::map<std::vector<std::string>,std::string> checksums;
+   for (unsigned int i = 0; i < record.size(); i++)
+   {
+      if (record[i].schema != version || record[i].files.size() == 0 ||
+          record[i].files[0] != std::string(xmlFile))
+      {
+         continue;
+      }
+      if (checksums.find(record[i].files) == checksums.end())
+      {
+         checksums[record[i].files] =
+                   resolver.ComputeMD5_checksum(record[i].files);
+      }
+      if (checksums[record[i].files] == record[i].checksum)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+// Adds the last checksum to the validation record of xmlFile,
+// failures are silently ignored since the record is only an aid.
+
+static void recordValidation(const XString& xmlFile,
+                             const std::string& version)
+{
+   std::string rfile = cacheFile(xmlFile, "validated");
+   if (rfile.size() == 0)
+   {
+      return;
+   }
+   std::vector<ValidationEntry> record = readValidationRecord(rfile);
+   ValidationEntry entry;
+   entry.checksum = last_md5_checksum;
+   entry.schema = version;
+   entry.files = last_md5_filenames;
+   record.insert(record.begin(), entry);
+
+   std::ostringstream tmpfile;
+   tmpfile << rfile << ".tmp" << getpid();
+   ofstream ofs(tmpfile.str().c_str());
+   unsigned int written = 0;
+   for (unsigned int i = 0; i < record.size() &&
+                            written < VALIDATION_RECORD_SIZE; i++)
+   {
+      if (i > 0 && record[i].checksum == entry.checksum &&
+                   record[i].schema == entry.schema)
+      {
+         continue;
+      }
+      ofs << record[i].checksum << " " << record[i].schema << " "
+          << record[i].files.size() << std::endl;
+      for (unsigned int n = 0; n < record[i].files.size(); n++)
+      {
+         ofs << record[i].files[n] << std::endl;
+      }
+      ++written;
+   }
+   ofs.close();
+   if (!ofs || rename(tmpfile.str().c_str(), rfile.c_str()) != 0)
+   {
+      remove(tmpfile.str().c_str());
+   }
+}
+
+// Returns the position just past the comment, CDATA section or
+// processing instruction that starts at position i of text, or i
+// if there is none there.
+
+static size_t skipMarkup(const std::string& text, size_t i)
+{
+   size_t end = i;
+   if (text.compare(i, 4, "<!--") == 0)
+   {
+      end = text.find("-->", i + 4);
+      end = (end == std::string::npos)? text.size() : end + 3;
+   }
+   else if (text.compare(i, 9, "<![CDATA[") == 0)
+   {
+      end = text.find("]]>", i + 9);
+      end = (end == std::string::npos)? text.size() : end + 3;
+   }
+   else if (text.compare(i, 2, "<?") == 0)
+   {
+      end = text.find("?>", i + 2);
+      end = (end == std::string::npos)? text.size() : end + 2;
+   }
+   return end;
+}
+
+static bool isPredefinedEntity(const std::string& name)
+{
+   return (name.size() > 0 && name[0] == '#') ||
+          name == "lt" || name == "gt" || name == "amp" ||
+          name == "quot" || name == "apos";
+}
+
+// Splits the top-level document into the skeleton and one fragment job
+// per reference to an external entity, in document order, and records
+// the entity files with the resolver in the order xerces would open
+// them.  Returns false if the document cannot be split this way.
+
+static bool splitDocument(MyEntityResolver& resolver, const XString& xmlFile,
+                          std::string& skeleton, FragmentList& jobs)
+{
+   const std::string* contents = resolver.GetXMLFile(xmlFile);
+   if (contents == 0)
+   {
+      return false;
+   }
+   const std::string& text = *contents;
+   size_t doctype = text.find("<!DOCTYPE");
+   size_t subsetEnd = text.find("]>", doctype);
+   if (doctype == std::string::npos || subsetEnd == std::string::npos)
+   {
+      return false;
+   }
+
+   // system identifiers of the general entities declared in the internal
+   // subset, empty for external entities that cannot be split out
+   std::map<std::string,std::string> systemIds;
+   size_t pos = doctype;
+   while ((pos = text.find("<!ENTITY", pos)) < subsetEnd)
+   {
+      size_t end = text.find('>', pos);
+      std::istringstream decl(text.substr(pos + 8, end - pos - 8));
+      std::string name;
+      std::string kind;
+      std::string sysid;
+      decl >> name >> kind >> sysid;
+      if (kind == "SYSTEM" && sysid.size() > 2 &&
+          sysid[0] == sysid[sysid.size() - 1] &&
+          (sysid[0] == '"' || sysid[0] == '\''))
+      {
+         systemIds[name] = sysid.substr(1, sysid.size() - 2);
+      }
+      else if (kind == "PUBLIC")
+      {
+         systemIds[name] = "";
+      }
+      pos = end;
+   }
+
+   std::string path;
+   size_t slash = xmlFile.find_last_of('/');
+   if (slash != std::string::npos)
+   {
+      path = xmlFile.substr(0,slash) + "/";
+   }
+   std::string rootTag;
+   std::string rootName;
+   size_t last = 0;
+   skeleton.clear();
+   for (size_t i = subsetEnd + 2; i < text.size(); )
+   {
+      size_t next = skipMarkup(text, i);
+      if (next != i)
+      {
+         i = next;
+      }
+      else if (text[i] == '<' && rootTag.size() == 0)
+      {
+         size_t end = text.find('>', i);
+         if (end == std::string::npos || text[end - 1] == '/')
+         {
+            return false;
+         }
+         rootTag = text.substr(i, end - i + 1);
+         rootName = text.substr(i + 1,
+                        text.find_first_of(" \t\r\n>", i) - i - 1);
+         i = end + 1;
+      }
+      else if (text[i] == '&')
+      {
+         size_t semi = text.find(';', i);
+         if (semi == std::string::npos)
+         {
+            return false;
+         }
+         std::string name = text.substr(i + 1, semi - i - 1);
+         std::map<std::string,std::string>::iterator iter;
+         if ((iter = systemIds.find(name)) != systemIds.end())
+         {
+            if (iter->second.size() == 0)
+            {
+               return false;
+            }
+            FragmentJob job;
+            job.fname = path + iter->second;
+            job.parser = 0;
+            job.failed = false;
+            job.deferred = false;
+            jobs.push_back(job);
+            skeleton += text.substr(last, i - last) +
+                        "<?" FRAGMENT_MARK " " + name + "?>";
+            last = semi + 1;
+         }
+         i = semi + 1;
+      }
+      else
+      {
+         ++i;
+      }
+   }
+   skeleton += text.substr(last);
+   if (jobs.size() < 2)
+   {
+      return false;
+   }
+
+   // wrap each fragment in a copy of the root element on the line of its
+   // text declaration, so the line numbers in messages stay the same
+   for (size_t n = 0; (n = rootTag.find_first_of("\r\n", n)) !=
+                      std::string::npos; )
+   {
+      rootTag[n] = ' ';
+   }
+   for (unsigned int j = 0; j < jobs.size(); j++)
+   {
+      const std::string* body = resolver.GetXMLFile(jobs[j].fname);
+      if (body == 0)
+      {
+         return false;
+      }
+      size_t start = 0;
+      std::string decl;
+      if (body->compare(0, 5, "<?xml") == 0)
+      {
+         start = skipMarkup(*body, 0);
+         decl = body->substr(0, start);
+         if (decl.find("version") == std::string::npos)
+         {
+            decl = "<?xml version=\"1.0\"" + decl.substr(5);
+         }
+      }
+      for (size_t i = start; i < body->size(); )
+      {
+         size_t next = skipMarkup(*body, i);
+         if (next != i)
+         {
+            i = next;
+         }
+         else if ((*body)[i] == '&')
+         {
+            size_t semi = body->find(';', i);
+            if (semi == std::string::npos ||
+                !isPredefinedEntity(body->substr(i + 1, semi - i - 1)))
+            {
+               return false;
+            }
+            i = semi + 1;
+         }
+         else
+         {
+            ++i;
+         }
+      }
+      jobs[j].text = decl + rootTag + body->substr(start) +
+                     "</" + rootName + ">";
+   }
+
+   for (unsigned int j = 0; j < jobs.size(); j++)
+   {
+      resolver.AddXMLFilename(jobs[j].fname,
+                              resolver.GetXMLFilenames().size());
+   }
+   return true;
+}
+
+static void parseFragment(FragmentJob& job)
+{
+   job.parser = new xercesc::XercesDOMParser(0,
+                    xercesc::XMLPlatformUtils::fgMemoryManager, grammarPool);
+   job.parser->setValidationScheme(xercesc::XercesDOMParser::Val_Never);
+   job.parser->setCreateEntityReferenceNodes(false);
+   job.parser->setDoNamespaces(true);
+   job.parser->setDoSchema(true);
+   job.parser->useCachedGrammarInParse(true);
+   job.parser->cacheGrammarFromParse(false);
+
+   MyOwnErrorHandler errorHandler;
+   job.parser->setErrorHandler(&errorHandler);
+   try
+   {
+      xercesc::MemBufInputSource source((const XMLByte*)job.text.data(),
+                                        job.text.size(), job.fname.c_str());
+      job.parser->parse(source);
+   }
+   catch (...)
+   {
+      std::cerr
+           << "\nparseInputDocument: Unexpected exception during parsing: '"
+           << job.fname << "'\n";
+      job.failed = true;
+   }
+   job.parser->setErrorHandler(0);
+   job.failed = job.failed || errorHandler.getSawErrors();
+}
+
+static void* fragmentWorker(void* arg)
+{
+   FragmentQueue* queue = (FragmentQueue*)arg;
+   while (true)
+   {
+      pthread_mutex_lock(&queue->mutex);
+      unsigned int next = queue->next++;
+      pthread_mutex_unlock(&queue->mutex);
+      if (next >= queue->order.size())
+      {
+         break;
+      }
+      parseFragment((*queue->jobs)[queue->order[next]]);
+   }
+   return 0;
+}
+
+// Parses all of the fragments, using up to nthreads threads including
+// the calling one, returns false if any of them failed.
+
+static bool parseFragments(FragmentList& jobs, int nthreads)
+{
+   FragmentQueue queue;
+   queue.jobs = &jobs;
+   queue.next = 0;
+   std::multimap<size_t,unsigned int> bySize;
+   for (unsigned int j = 0; j < jobs.size(); j++)
+   {
+      if (! jobs[j].deferred)
+         bySize.insert(std::pair<size_t,unsigned int>(jobs[j].text.size(), j));
+   }
+   std::multimap<size_t,unsigned int>::reverse_iterator iter;
+   for (iter = bySize.rbegin(); iter != bySize.rend(); ++iter)
+   {
+      queue.order.push_back(iter->second);
+   }
+   pthread_mutex_init(&queue.mutex, 0);
+
+   // the parsers only read from the locked pool, which makes it safe
+   // to share between the threads
+   grammarPool->lockPool();
+   std::vector<pthread_t> threads;
+   for (int t = 1; t < nthreads && t < (int)queue.order.size(); t++)
+   {
+      pthread_t thread;
+      if (pthread_create(&thread, 0, fragmentWorker, &queue) == 0)
+      {
+         threads.push_back(thread);
+      }
+   }
+   fragmentWorker(&queue);
+   for (unsigned int t = 0; t < threads.size(); t++)
+   {
+      pthread_join(threads[t], 0);
+   }
+   grammarPool->unlockPool();
+   pthread_mutex_destroy(&queue.mutex);
+
+   bool ok = true;
+   for (unsigned int j = 0; j < jobs.size(); j++)
+   {
+      ok = ok && !jobs[j].failed;
+   }
+   return ok;
+}
+
+// Makes a deep copy of a fragment node in doc.  Attributes that the
+// schema filled in with their default values are copied like the others
+// and ID attributes are declared as such on the copy, so that
+// getElementById sees the stitched document the way it sees one that
+// was parsed in one piece.
+
+static xercesc::DOMNode* importFragmentNode(xercesc::DOMDocument* doc,
+                                            const xercesc::DOMNode* src)
+{
+   switch (src->getNodeType())
+   {
+      case xercesc::DOMNode::ELEMENT_NODE:
+      {
+         xercesc::DOMElement* el = doc->createElementNS(
+                                   src->getNamespaceURI(), src->getNodeName());
+         xercesc::DOMNamedNodeMap* attrList = src->getAttributes();
+         for (unsigned int a = 0; a < attrList->getLength(); a++)
+         {
+            xercesc::DOMAttr* attr = (xercesc::DOMAttr*)attrList->item(a);
+            el->setAttributeNS(attr->getNamespaceURI(), attr->getName(),
+                               attr->getValue());
+            if (attr->isId())
+            {
+               el->setIdAttribute(attr->getName(), true);
+            }
+         }
+         for (xercesc::DOMNode* child = src->getFirstChild();
+              child != 0;
+              child = child->getNextSibling())
+         {
+            xercesc::DOMNode* node = importFragmentNode(doc, child);
+            if (node != 0)
+            {
+               el->appendChild(node);
+            }
+         }
+         return el;
+      }
+      case xercesc::DOMNode::TEXT_NODE:
+         return doc->createTextNode(src->getNodeValue());
+      case xercesc::DOMNode::CDATA_SECTION_NODE:
+         return doc->createCDATASection(src->getNodeValue());
+      case xercesc::DOMNode::COMMENT_NODE:
+         return doc->createComment(src->getNodeValue());
+      case xercesc::DOMNode::PROCESSING_INSTRUCTION_NODE:
+         return doc->createProcessingInstruction(
+                ((xercesc::DOMProcessingInstruction*)src)->getTarget(),
+                ((xercesc::DOMProcessingInstruction*)src)->getData());
+      default:
+         return 0;
+   }
+}
+
+static void findFragmentMarks(xercesc::DOMNode* node,
+                              std::vector<xercesc::DOMNode*>& marks)
+{
+   for (xercesc::DOMNode* child = node->getFirstChild();
+        child != 0;
+        child = child->getNextSibling())
+   {
+      if (child->getNodeType() ==
+          xercesc::DOMNode::PROCESSING_INSTRUCTION_NODE &&
+          XString(((xercesc::DOMProcessingInstruction*)child)->getTarget())
+          == FRAGMENT_MARK)
+      {
+         marks.push_back(child);
+      }
+      else
+      {
+         findFragmentMarks(child, marks);
+      }
+   }
+}
+
+// Replaces a mark in the skeleton document with the contents of the
+// root element of its fragment, and gives back the fragment parser.
+
+static void stitchFragment(xercesc::DOMNode* mark, FragmentJob& job)
+{
+   xercesc::DOMDocument* doc = mark->getOwnerDocument();
+   xercesc::DOMNode* parent = mark->getParentNode();
+   xercesc::DOMElement* root = job.parser->getDocument()->getDocumentElement();
+   for (xercesc::DOMNode* child = root->getFirstChild();
+        child != 0;
+        child = child->getNextSibling())
+   {
+      xercesc::DOMNode* node = importFragmentNode(doc, child);
+      if (node != 0)
+      {
+         parent->insertBefore(node, mark);
+      }
+   }
+   parent->removeChild(mark)->release();
+   parent->normalize();
+   delete job.parser;
+   job.parser = 0;
+}
+
+// Stitches all fragments that have been parsed into the skeleton document
+// and returns the marks of all of them, or false if they do not match.
+
+static bool stitchFragments(xercesc::DOMDocument* doc, FragmentList& jobs,
+                            std::vector<xercesc::DOMNode*>& marks)
+{
+   findFragmentMarks(doc, marks);
+   if (marks.size() != jobs.size())
+   {
+      return false;
+   }
+   for (unsigned int k = 0; k < marks.size(); k++)
+   {
+      if (! jobs[k].deferred)
+      {
+         stitchFragment(marks[k], jobs[k]);
+      }
+   }
+   return true;
+}
+
+// Adds the elements in text, starting from position start, to the index
+// of a lazy document and returns the tag of the first element inside the
+// outermost one.
+
+static std::string indexLazyText(LazyDocument& lazy, int fragment,
+                                 const std::string& text, size_t start)
+{
+   std::string firstTag;
+   std::vector<std::string> owners;	// innermost id of each open element
+   for (size_t i = start; i < text.size(); )
+   {
+      size_t next = skipMarkup(text, i);
+      if (next != i)
+      {
+         i = next;
+         continue;
+      }
+      else if (text[i] != '<')
+      {
+         ++i;
+         continue;
+      }
+      size_t end = text.find('>', i);
+      if (end == std::string::npos)
+      {
+         break;
+      }
+      if (text[i + 1] == '/' || text[i + 1] == '!')
+      {
+         if (text[i + 1] == '/' && owners.size() > 0)
+         {
+            owners.pop_back();
+         }
+         i = end + 1;
+         continue;
+      }
+
+      // an element start tag, read its name and attributes
+      size_t p = text.find_first_of(" \t\r\n/>", i + 1);
+      std::string tag = text.substr(i + 1, p - i - 1);
+      std::vector<std::pair<std::string,std::string> > attrs;
+      while (p < text.size())
+      {
+         p = text.find_first_not_of(" \t\r\n", p);
+         if (p == std::string::npos || text[p] == '>' || text[p] == '/')
+         {
+            break;
+         }
+         size_t eq = text.find('=', p);
+         size_t open = text.find_first_of("\"'", eq);
+         size_t close = (open == std::string::npos)? open :
+                        text.find(text[open], open + 1);
+         if (close == std::string::npos)
+         {
+            return firstTag;
+         }
+         std::string name = text.substr(p, eq - p);
+         name = name.substr(0, name.find_first_of(" \t\r\n"));
+         attrs.push_back(std::make_pair(name,
+                         text.substr(open + 1, close - open - 1)));
+         p = close + 1;
+      }
+      end = text.find('>', p);
+      if (end == std::string::npos)
+      {
+         break;
+      }
+      if (owners.size() == 1 && firstTag.size() == 0)
+      {
+         firstTag = tag;
+      }
+
+      std::string owner = (owners.size() > 0)? owners.back() : "";
+      for (unsigned int a = 0; a < attrs.size(); a++)
+      {
+         if (attrs[a].first == LAZY_ID_ATTRIBUTE)
+         {
+            std::string id = attrs[a].second;
+            if (lazy.definedIn.find(id) == lazy.definedIn.end())
+            {
+               lazy.definedIn[id] = fragment;
+            }
+            if (owner.size() > 0)
+            {
+               lazy.references[owner].push_back(id);
+            }
+            owner = id;
+            break;
+         }
+      }
+      for (unsigned int a = 0; a < attrs.size(); a++)
+      {
+         if (attrs[a].first != LAZY_ID_ATTRIBUTE && owner.size() > 0 &&
+             attrs[a].second.find_first_of(" \t\r\n") == std::string::npos)
+         {
+            lazy.references[owner].push_back(attrs[a].second);
+         }
+      }
+      if (text[end - 1] != '/')
+      {
+         owners.push_back(owner);
+      }
+      i = end + 1;
+   }
+   return firstTag;
+}
+
+/*
+ * The name index of a document is an open addressing hash table from
+ * the value of each ID attribute to a handle, the position of the
+ * element in the elements list.  It answers the same questions as
+ * getElementById without transcoding the name or walking the xerces
+ * id map.
+ */
+
+struct NameIndex
+{
+   std::vector<std::string> names;		// by handle
+   std::vector<xercesc::DOMElement*> elements;	// by handle
+   std::vector<int> slots;			// handles, -1 if empty
+
+   int find(const std::string& name) const;	// handle, or -1
+   void insert(const std::string& name, xercesc::DOMElement* el);
+
+   static unsigned int hash(const std::string& name);
+};
+
+static std::map<const xercesc::DOMDocument*,NameIndex*> nameIndexes;
+
+unsigned int NameIndex::hash(const std::string& name)
+{
+   unsigned int h = 2166136261u;
+   for (unsigned int i = 0; i < name.size(); i++)
+   {
+      h = (h ^ (unsigned char)name[i]) * 16777619u;
+   }
+   return h;
+}
+
+int NameIndex::find(const std::string& name) const
+{
+   if (slots.size() == 0)
+   {
+      return -1;
+   }
+   unsigned int mask = slots.size() - 1;
+   for (unsigned int i = hash(name) & mask; slots[i] >= 0; i = (i+1) & mask)
+   {
+      if (names[slots[i]] == name)
+      {
+         return slots[i];
+      }
+   }
+   return -1;
+}
+
+void NameIndex::insert(const std::string& name, xercesc::DOMElement* el)
+{
+   if (find(name) >= 0)
+   {
+      return;
+   }
+   names.push_back(name);
+   elements.push_back(el);
+   if (2 * names.size() > slots.size())
+   {
+      unsigned int size = (slots.size() > 0)? 2 * slots.size() : 256;
+      slots.assign(size, -1);
+      for (unsigned int handle = 0; handle < names.size(); handle++)
+      {
+         unsigned int i = hash(names[handle]) & (size - 1);
+         while (slots[i] >= 0)
+         {
+            i = (i + 1) & (size - 1);
+         }
+         slots[i] = handle;
+      }
+   }
+   else
+   {
+      unsigned int mask = slots.size() - 1;
+      unsigned int i = hash(name) & mask;
+      while (slots[i] >= 0)
+      {
+         i = (i + 1) & mask;
+      }
+      slots[i] = names.size() - 1;
+   }
+}
+
+static void indexNames(NameIndex& index, xercesc::DOMNode* node)
+{
+   for (; node != 0; node = node->getNextSibling())
+   {
+      if (node->getNodeType() != xercesc::DOMNode::ELEMENT_NODE)
+      {
+         continue;
+      }
+      xercesc::DOMElement* el = (xercesc::DOMElement*)node;
+      xercesc::DOMNamedNodeMap* attrs = el->getAttributes();
+      for (unsigned int a = 0; a < attrs->getLength(); a++)
+      {
+         xercesc::DOMAttr* attr = (xercesc::DOMAttr*)attrs->item(a);
+         if (attr->isId())
+         {
+            index.insert(XString(attr->getValue()), el);
+         }
+      }
+      indexNames(index, el->getFirstChild());
+   }
+}
+
+static void buildNameIndex(xercesc::DOMDocument* doc)
+{
+   NameIndex*& index = nameIndexes[doc];
+   delete index;
+   index = new NameIndex;
+   indexNames(*index, doc->getDocumentElement());
+}
+
+static void releaseNameIndex(const xercesc::DOMDocument* doc)
+{
+   std::map<const xercesc::DOMDocument*,NameIndex*>::iterator iter;
+   if ((iter = nameIndexes.find(doc)) != nameIndexes.end())
+   {
+      delete iter->second;
+      nameIndexes.erase(iter);
+   }
+}
+
+static void releaseLazyDocument(const xercesc::DOMDocument* doc)
+{
+   std::map<const xercesc::DOMDocument*,LazyDocument*>::iterator iter;
+   if ((iter = lazyDocuments.find(doc)) != lazyDocuments.end())
+   {
+      delete iter->second;
+      lazyDocuments.erase(iter);
+   }
+}
+
+static xercesc::DOMElement* lookupElementById(xercesc::DOMDocument* doc,
+                                              const XString& id)
+{
+   xercesc::DOMElement* el = doc->getElementById(XString(id).unicode_str());
+   std::map<const xercesc::DOMDocument*,LazyDocument*>::iterator iter;
+   if (el != 0 || (iter = lazyDocuments.find(doc)) == lazyDocuments.end())
+   {
+      return el;
+   }
+   LazyDocument* lazy = iter->second;
+   std::map<std::string,int>::iterator def = lazy->definedIn.find(id);
+   if (def == lazy->definedIn.end() || def->second < 0 ||
+       ! lazy->fragments[def->second].deferred)
+   {
+      return 0;
+   }
+   FragmentJob& job = lazy->fragments[def->second];
+   job.deferred = false;
+   parseFragment(job);
+   if (job.failed)
+   {
+      std::cerr
+           << "\nloadElementById: Errors occured loading '" << job.fname
+           << "'\n" << std::endl;
+      return 0;
+   }
+   stitchFragment(lazy->marks[def->second], job);
+   return doc->getElementById(XString(id).unicode_str());
+}
+
+xercesc::DOMElement* loadElementById(xercesc::DOMDocument* doc,
+                                     const XString& id)
+{
+   std::map<const xercesc::DOMDocument*,NameIndex*>::iterator index;
+   index = nameIndexes.find(doc);
+   if (index != nameIndexes.end())
+   {
+      int handle = index->second->find(id);
+      if (handle >= 0)
+      {
+         return index->second->elements[handle];
+      }
+   }
+   xercesc::DOMElement* el = lookupElementById(doc, id);
+   if (el != 0 && index != nameIndexes.end())
+   {
+      index->second->insert(id, el);
+   }
+   return el;
+}
+
+bool isPartialDocument(const xercesc::DOMDocument* doc)
+{
+   return (lazyDocuments.find(doc) != lazyDocuments.end());
+}
+
+bool mayReference(const xercesc::DOMDocument* doc,
+                  const XString& fromId, const XString& toId)
+{
+   std::map<const xercesc::DOMDocument*,LazyDocument*>::iterator iter;
+   if ((iter = lazyDocuments.find(doc)) == lazyDocuments.end())
+   {
+      return true;
+   }
+   LazyDocument* lazy = iter->second;
+   if (lazy->target != toId || lazy->reachers.size() == 0)
+   {
+      // walk the references backwards from the target once per target
+      std::map<std::string,std::vector<std::string> > referencedBy;
+      std::map<std::string,std::vector<std::string> >::iterator ref;
+      for (ref = lazy->references.begin();
+           ref != lazy->references.end();
+           ++ref)
+      {
+         for (unsigned int n = 0; n < ref->second.size(); n++)
+         {
+            referencedBy[ref->second[n]].push_back(ref->first);
+         }
+      }
+      lazy->target = toId;
+      lazy->reachers.clear();
+      lazy->reachers.insert(toId);
+      std::vector<std::string> todo(1, toId);
+      while (todo.size() > 0)
+      {
+         std::string id = todo.back();
+         todo.pop_back();
+         std::vector<std::string>& from = referencedBy[id];
+         for (unsigned int n = 0; n < from.size(); n++)
+         {
+            if (lazy->reachers.insert(from[n]).second)
+            {
+               todo.push_back(from[n]);
+            }
+         }
+      }
+   }
+   return (lazy->reachers.count(fromId) > 0);
+}
+
 xercesc::DOMDocument* parseInputDocument(const XString& xmlFile, bool keep)
 {
-   static xercesc::XercesDOMParser* scratchParser=0;
+   if (!keep && scratchParser != 0)
+   {
+      releaseLazyDocument(scratchParser->getDocument());
+      releaseNameIndex(scratchParser->getDocument());
+   }
+
+   // every file is read once by the resolver, which holds on to the
+   // contents for the schema lookup, the validation record, the parser
+   // and the MD5 checksum
+   MyEntityResolver myEntityResolver(xmlFile);
+
+   std::string schemaFile = findSchemaFile(myEntityResolver, xmlFile);
+   std::string version = schemaVersion(myEntityResolver, schemaFile);
+   bool validated = (schemaFile.size() > 0 &&
+                     wasValidated(myEntityResolver, xmlFile, version));
+   if (grammarPool == 0)
+   {
+      grammarPool = new xercesc::XMLGrammarPoolImpl(
+                        xercesc::XMLPlatformUtils::fgMemoryManager);
+      if (schemaFile.size() > 0 && loadGrammar(schemaFile, version))
+      {
+         grammarSchema = schemaFile;
+      }
+   }
+   bool pooled = (schemaFile.size() > 0 && schemaFile == grammarSchema);
+
+   // only a document that is known to be valid can be parsed in pieces,
+   // since the fragments cannot be validated on their own
+   std::string skeleton;
+   FragmentList fragments;
+   int nthreads = parseThreadCount();
+   bool split = (validated && pooled && (nthreads > 1 || lazyLoading) &&
+                 splitDocument(myEntityResolver, xmlFile,
+                               skeleton, fragments));
+   LazyDocument* lazy = 0;
+   if (split && lazyLoading)
+   {
+      // the materials and regions are needed whatever part of the
+      // geometry is looked at, the other fragments wait to be asked for
+      lazy = new LazyDocument;
+      const std::string* contents = myEntityResolver.GetXMLFile(xmlFile);
+      indexLazyText(*lazy, -1, *contents,
+                    contents->find("]>", contents->find("<!DOCTYPE")) + 2);
+      for (unsigned int j = 0; j < fragments.size(); j++)
+      {
+         std::string tag = indexLazyText(*lazy, j, fragments[j].text, 0);
+         fragments[j].deferred = (tag != "materials" && tag != "regions");
+      }
+   }
+
    xercesc::XercesDOMParser* parser;
    if (keep)
    {
-      parser = new xercesc::XercesDOMParser;
+      parser = new xercesc::XercesDOMParser(0,
+                   xercesc::XMLPlatformUtils::fgMemoryManager, grammarPool);
    }
    else if (scratchParser == 0)
    {
-      parser = scratchParser = new xercesc::XercesDOMParser;
+      parser = scratchParser = new xercesc::XercesDOMParser(0,
+                   xercesc::XMLPlatformUtils::fgMemoryManager, grammarPool);
    }
    else
    {
       parser = scratchParser;
    }
    
-   MyEntityResolver myEntityResolver(xmlFile);
-   
-   parser->setValidationScheme(xercesc::XercesDOMParser::Val_Auto);
+   // A document whose checksum passed validation before is parsed without
+   // validation.  The schema is still processed because it supplies the
+   // default attribute values and the ID attributes of the document.
+   if (validated)
+   {
+      parser->setValidationScheme(xercesc::XercesDOMParser::Val_Never);
+      parser->setValidationSchemaFullChecking(false);
+   }
+   else
+   {
+      parser->setValidationScheme(xercesc::XercesDOMParser::Val_Auto);
+      parser->setValidationSchemaFullChecking(true);
+   }
    parser->setCreateEntityReferenceNodes(false);
-   parser->setValidationSchemaFullChecking(true);
    parser->setDoNamespaces(true);
    parser->setDoSchema(true);
    parser->setEntityResolver(&myEntityResolver);
+   parser->useCachedGrammarInParse(pooled);
+   parser->cacheGrammarFromParse(grammarSchema.size() == 0);
 
    MyOwnErrorHandler errorHandler;
    parser->setErrorHandler(&errorHandler);
 
    try
    {
-      parser->parse(xmlFile.c_str());
+      const std::string* contents = myEntityResolver.GetXMLFile(xmlFile);
+      if (split)
+      {
+         if (! parseFragments(fragments, nthreads))
+         {
+            std::cerr << "\nErrors occured, no output available\n"
+                      << std::endl;
+            delete lazy;
+            return 0;
+         }
+         xercesc::MemBufInputSource source((const XMLByte*)skeleton.data(),
+                                           skeleton.size(), xmlFile.c_str());
+         parser->parse(source);
+      }
+      else if (contents == 0)
+      {
+         parser->parse(xmlFile.c_str());  // let xerces report the error
+      }
+      else
+      {
+         xercesc::MemBufInputSource source((const XMLByte*)contents->data(),
+                                           contents->size(), xmlFile.c_str());
+         parser->parse(source);
+      }
+      if (pooled && grammarPosition >= 0)
+      {
+         myEntityResolver.AddXMLFilename(schemaFile, grammarPosition);
+      }
 	  myEntityResolver.GetMD5_checksum();
    }
    catch (const xercesc::XMLException& toCatch)
@@ -110,6 +1422,7 @@ xercesc::DOMDocument* parseInputDocument(const XString& xmlFile, bool keep)
            << "\nparseInputDocument: Error during parsing: '" << xmlFile
 	   << "'\n" << "Exception message is:  \n"
            << toCatch.getMessage() << "\n" << std::endl;
+      delete lazy;
       return 0;
    }
    catch (const xercesc::DOMException& toCatch)
@@ -118,6 +1431,7 @@ xercesc::DOMDocument* parseInputDocument(const XString& xmlFile, bool keep)
            << "\nXParsers: Error during parsing: '" << xmlFile << "'\n"
            << "Exception message is:  \n"
            << toCatch.msg << "\n" << std::endl;
+      delete lazy;
       xercesc::XMLPlatformUtils::Terminate();
       return 0;
    }
@@ -126,6 +1440,7 @@ xercesc::DOMDocument* parseInputDocument(const XString& xmlFile, bool keep)
       std::cerr
            << "\nparseInputDocument: Unexpected exception during parsing: '"
            << xmlFile << "'\n";
+      delete lazy;
       xercesc::XMLPlatformUtils::Terminate();
       return 0;
    }
@@ -133,12 +1448,63 @@ xercesc::DOMDocument* parseInputDocument(const XString& xmlFile, bool keep)
    if (errorHandler.getSawErrors())
    {
       std::cerr << "\nErrors occured, no output available\n" << std::endl;
+      delete lazy;
+      return 0;
+   }
+
+   std::vector<xercesc::DOMNode*> marks;
+   if (split && ! stitchFragments(parser->getDocument(), fragments, marks))
+   {
+      std::cerr
+           << "\nparseInputDocument: Error joining the pieces of '"
+           << xmlFile << "'\n" << std::endl;
+      delete lazy;
       return 0;
    }
+   if (lazy != 0)
+   {
+      lazy->fragments.swap(fragments);
+      lazy->marks = marks;
+      lazyDocuments[parser->getDocument()] = lazy;
+   }
+
+   if (!pooled && grammarSchema.size() == 0 && schemaFile.size() > 0)
+   {
+      std::vector<std::string> files = myEntityResolver.GetXMLFilenames();
+      for (unsigned int i = 0; i < files.size(); i++)
+      {
+         if (files[i] == schemaFile)
+         {
+            grammarSchema = schemaFile;
+            grammarPosition = i;
+            saveGrammar(schemaFile, version, grammarPosition);
+            break;
+         }
+      }
+   }
 
+   if (!validated && schemaFile.size() > 0)
+   {
+      recordValidation(xmlFile, version);
+   }
+
+   buildNameIndex(parser->getDocument());
    return parser->getDocument();
 }
 
+void releaseInputDocument()
+{
+   // destroys the scratch parser together with the document it owns,
+   // a later call to parseInputDocument will make a new one
+   if (scratchParser != 0)
+   {
+      releaseLazyDocument(scratchParser->getDocument());
+      releaseNameIndex(scratchParser->getDocument());
+   }
+   delete scratchParser;
+   scratchParser = 0;
+}
+
 xercesc::DOMDocument* buildDOMDocument(const XString& xmlFile, bool keep)
 {
 return parseInputDocument(xmlFile, keep);
@@ -184,12 +1550,12 @@ return parseInputDocument(xmlFile, keep);
       xercesc::DOMWriter* writer = ((xercesc::DOMImplementationLS*)impl)->
                                     createDOMWriter();
       xercesc::LocalFileFormatTarget* lfft =
-                     new xercesc::LocalFileFormatTarget(X(tmpFileS));
+                     new xercesc::LocalFileFormatTarget(tmpFileS.unicode_str());
       writer->writeNode(lfft,*(doc->getDocumentElement()));
       delete lfft;
       delete writer;
       builder->resetDocumentPool();
-      doc = builder->parseURI(X(tmpFileS));
+      doc = builder->parseURI(tmpFileS.unicode_str());
 #endif
    }
    catch (const xercesc::XMLException& toCatch) {
@@ -333,8 +1699,9 @@ xercesc::InputSource* MyEntityResolver::resolveEntity(const XMLCh* const publicI
 {
 	/// This method gets called from the xerces parser each time it
 	/// opens a file (except for the top-level file). For each of these,
-	/// record the name of the file being opened, then just return NULL
-	/// to have xerces handle opening the file in the normal way.
+	/// record the name of the file being opened, then hand xerces the
+	/// contents from memory so the file is only read once. Files that
+	/// cannot be read are left to xerces, which reports the error.
 
 	// Do some backflips to get strings into std::string format
 	std::string my_publicId = "";
@@ -352,9 +1719,48 @@ xercesc::InputSource* MyEntityResolver::resolveEntity(const XMLCh* const publicI
 	//std::cerr<<"publicId="<<my_publicId<<"  systemId="<<my_systemId<<std::endl;
 
 	// The systemId seems to be the one we want
-	xml_filenames.push_back(path + my_systemId);
+	std::string fname = path + my_systemId;
+	xml_filenames.push_back(fname);
+
+	const std::string *contents = GetXMLFile(fname);
+	if(contents == NULL) return NULL; // have xerces handle this using its defaults
+
+	// xerces adopts the input source, the bytes stay with the resolver
+	return new xercesc::MemBufInputSource((const XMLByte*)contents->data(),
+	                                      contents->size(), fname.c_str());
+}
+
+//----------------------------------
+// GetXMLFile
+//----------------------------------
+const std::string* MyEntityResolver::GetXMLFile(const std::string& fname)
+{
+	/// Returns the contents of the file, reading it in on the first
+	/// request and keeping it for the lifetime of the resolver, or
+	/// NULL if the file cannot be read.
+
+	std::map<std::string,std::string>::iterator iter = xml_contents.find(fname);
+	if(iter != xml_contents.end()) return &iter->second;
+	if(xml_unreadable.count(fname)) return NULL;
+
+	ifstream ifs(fname.c_str(), ios::in | ios::binary);
+	if(!ifs.is_open()){
+		xml_unreadable.insert(fname);
+		return NULL;
+	}
 
-	return NULL; // have xerces handle this using its defaults
+	// get length of file:
+	ifs.seekg (0, ios::end);
+	unsigned int length = ifs.tellg();
+	ifs.seekg (0, ios::beg);
+
+	// read data as a block:
+	std::string &contents = xml_contents[fname];
+	contents.resize(length);
+	if(length > 0) ifs.read (&contents[0],length);
+	ifs.close();
+
+	return &contents;
 }
 
 //----------------------------------
@@ -365,42 +1771,53 @@ std::vector<std::string> MyEntityResolver::GetXMLFilenames(void)
 	return xml_filenames;
 }
 
+//----------------------------------
+// AddXMLFilename
+//----------------------------------
+void MyEntityResolver::AddXMLFilename(const std::string& fname, unsigned int position)
+{
+	/// Records a file that went into the parse without being opened
+	/// through resolveEntity, such as a schema taken from the grammar
+	/// pool, at the given position in the list of XML files.
+
+	if(position > xml_filenames.size()) position = xml_filenames.size();
+	xml_filenames.insert(xml_filenames.begin() + position, fname);
+}
+
 //----------------------------------
 // GetMD5_checksum
 //----------------------------------
 std::string MyEntityResolver::GetMD5_checksum(void)
 {
 	/// This will calculate an MD5 checksum using all of the files currently
-	/// in the list of XML files. To do this, it opens each file and reads it
-	/// in, in its entirety, updating the checksum as it goes. The checksum is
-	/// returned as a hexadecimal string.
-
-	md5_state_t pms;
-	md5_init(&pms);
-	for(unsigned int i=0; i<xml_filenames.size(); i++){
-
-		//std::cerr<<".... Adding file to MD5 checksum : " << xml_filenames[i] << std::endl;
-	
-		ifstream ifs(xml_filenames[i].c_str());
-		if(!ifs.is_open())continue;
+	/// in the list of XML files. The checksum and the list of files that
+	/// went into it are also left in the globals last_md5_checksum and
+	/// last_md5_filenames.
 
-		// get length of file:
-		ifs.seekg (0, ios::end);
-		unsigned int length = ifs.tellg();
-		ifs.seekg (0, ios::beg);
+	last_md5_filenames = xml_filenames;
+	return last_md5_checksum = ComputeMD5_checksum(xml_filenames);
+}
 
-		// allocate memory:
-		char *buff = new char [length];
+//----------------------------------
+// ComputeMD5_checksum
+//----------------------------------
+std::string MyEntityResolver::ComputeMD5_checksum(const std::vector<std::string>& files)
+{
+	/// To calculate the checksum, take the contents of each file in
+	/// turn, reading in the ones not seen yet, and update the checksum
+	/// as it goes. Files that cannot be opened are skipped. The checksum
+	/// is returned as a hexadecimal string.
 
-		// read data as a block:
-		ifs.read (buff,length);
-		ifs.close();
+	md5_state_t pms;
+	md5_init(&pms);
+	for(unsigned int i=0; i<files.size(); i++){
 
-		md5_append(&pms, (const md5_byte_t *)buff, length);
+		const std::string *contents = GetXMLFile(files[i]);
+		if(contents == NULL)continue;
 
-		delete[] buff;
+		md5_append(&pms, (const md5_byte_t *)contents->data(), contents->size());
 
-		//std::cerr<<".... Adding file to MD5 checksum : " << xml_filenames[i] << "  (size=" << length << ")" << std::endl;
+		//std::cerr<<".... Adding file to MD5 checksum : " << files[i] << "  (size=" << contents->size() << ")" << std::endl;
 	}
 	
 	md5_byte_t digest[16];
@@ -409,6 +1826,17 @@ std::string MyEntityResolver::GetMD5_checksum(void)
 	char hex_output[16*2 + 1];
 	for(int di = 0; di < 16; ++di) sprintf(hex_output + di * 2, "%02x", digest[di]);
 
-	return last_md5_checksum = hex_output;
+	return hex_output;
 }
 
+//----------------------------------
+// computeMD5checksum
+//----------------------------------
+std::string computeMD5checksum(const std::vector<std::string>& files)
+{
+	/// Checksum of a list of files outside of any parse, made the
+	/// same way as the one in MyEntityResolver.
+
+	MyEntityResolver reader("");
+	return reader.ComputeMD5_checksum(files);
+}
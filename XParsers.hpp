@@ -18,12 +18,15 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <map>
+#include <set>
 
 #include "XString.hpp"
 
 
 // Filled by parseInputDocument using MyEntityResolver class
 extern std::string last_md5_checksum;
+extern std::vector<std::string> last_md5_filenames;
 
 
 /* a simple error handler to install on XercesDOMParser */
@@ -79,7 +82,8 @@ inline bool MyDOMErrorHandler::getSawErrors() const
 
 // A simple entity resolver to keep track of files being
 // included from the top-level XML file so a full MD5 sum
-// can be made
+// can be made. Each file is read only once, the parser
+// and the MD5 sum both work from the bytes kept in memory.
 class MyEntityResolver : public xercesc::EntityResolver
 {
 public:
@@ -90,15 +94,47 @@ public:
 	
 	xercesc::InputSource* resolveEntity(const XMLCh* const publicId, const XMLCh* const systemId);
 
+	const std::string* GetXMLFile(const std::string& fname);
 	std::vector<std::string> GetXMLFilenames(void);
+	void AddXMLFilename(const std::string& fname, unsigned int position);
 	std::string GetMD5_checksum(void);
+	std::string ComputeMD5_checksum(const std::vector<std::string>& files);
 
 private:
 	std::vector<std::string> xml_filenames;
+	std::map<std::string,std::string> xml_contents;
+	std::set<std::string> xml_unreadable;
 	std::string path;
 };
 
+std::string computeMD5checksum(const std::vector<std::string>& files);
+
 xercesc::DOMDocument* parseInputDocument(const XString& file, bool keep);
 xercesc::DOMDocument* buildDOMDocument(const XString& file, bool keep);
+void releaseInputDocument();
+
+// The schema grammar is compiled once and kept in a serialized form
+// next to the schema file (see parseInputDocument), calling this with
+// rebuild=true makes the next parse recompile and rewrite it.
+void setGrammarRebuild(bool rebuild);
+
+// Previously validated documents have their included files parsed side
+// by side on this many threads, 0 (the default) means one per cpu and 1
+// turns this off.
+void setParseThreads(int nthreads);
+
+// In lazy loading mode the included files of a previously validated
+// document, apart from the materials and regions, are left unparsed
+// until loadElementById needs an element from one of them.  If that
+// file fails to parse, loadElementById returns 0 for its elements.
+void setLazyLoading(bool lazy);
+xercesc::DOMElement* loadElementById(xercesc::DOMDocument* doc,
+                                     const XString& id);
+bool isPartialDocument(const xercesc::DOMDocument* doc);
+
+// True unless the element fromId of a lazily loaded document is known
+// not to lead to toId through any chain of references, loaded or not.
+bool mayReference(const xercesc::DOMDocument* doc,
+                  const XString& fromId, const XString& toId);
 
 #endif
@@ -5,10 +5,20 @@
  * Class implementation
  * September 21, 2003
  * Richard Jones
+ *
+ * Modification Notes:
+ * --------------------
+ * 10/17/2026 AG
+ *   Added the XName class for the tag and attribute names written in
+ *   the code.  It widens the ascii characters into a buffer of its own,
+ *   so these names no longer go through the transcoder on every use.
+ *   The constructor from XMLCh now gives the transcoded buffer back at
+ *   once instead of keeping it in fStringCollection.
  */
 
 #include "XString.hpp"
 #include <iostream>
+#include <stdlib.h>
 
 int dumper = 0;
 
@@ -23,8 +33,8 @@ XString::XString(const XMLCh* const x)
    if (x)
    {
       char* str = xercesc::XMLString::transcode(x);
-      fStringCollection.push_back(str);
       (std::string&)*this = str;
+      xercesc::XMLString::release(&str);
    }
 }
 
@@ -83,6 +93,22 @@ const XString XString::basename() const
    return s;
 }
 
+XName::XName(const char* const s)
+{
+   int n = 0;
+   for (; s[n] != 0; ++n)
+   {
+      if (n == kMaxLength || (s[n] & 0x80))
+      {
+         std::cerr << "XName: \"" << s << "\" is not a short ascii name"
+                   << std::endl;
+         abort();
+      }
+      fStr[n] = (XMLCh)s[n];
+   }
+   fStr[n] = 0;
+}
+
 void XString::dump()
 {
    std::cerr << ">>> XString dump:" << std::endl
@@ -37,10 +37,30 @@ class XString: public std::string
    const XMLCh* unicode_str();      // must modify the object because it
                                     // has to keep track of memory usage.
 
+
  private:
    std::list<char*> fStringCollection;
   
    void dump();
 };
 
+class XName
+{
+
+/* The XName class holds the unicode form of a short ascii name, such
+ * as a tag or attribute name written in the code.  The characters are
+ * widened in place instead of going through the transcoder, so an XName
+ * costs neither a lock nor an allocation, and constant XNames can be set
+ * up before Xerces is initialized.  Names that come from the document
+ * or the user belong in an XString.
+ */
+ public :
+   XName(const char* const s);
+   operator const XMLCh*() const { return fStr; }
+
+ private:
+   enum { kMaxLength = 31 };
+   XMLCh fStr[kMaxLength + 1];
+};
+
 #endif
@@ -48,15 +48,18 @@ using namespace xercesc;
 #include <list>
 #include <map>
 
-#define X(str) XString(str).unicode_str()
+#define X(str) XName(str)
 #define S(str) str.c_str()
 
 void usage()
 {
     std::cerr
-         << "Usage:    " << APP_NAME << " [-v] {HDDS file} {volume}"
+         << "Usage:    " << APP_NAME << " [-v] [-g] [-l] {HDDS file} {volume}"
          << std::endl <<  "Options:" << std::endl
-         << "    -v   validate only" << std::endl;
+         << "    -v   validate only" << std::endl
+         << "    -l   parse only the detector files the search needs"
+         << std::endl
+         << "    -g   recompile the cached schema grammar" << std::endl;
 }
 
 int main(int argC, char* argV[])
@@ -88,6 +91,7 @@ int main(int argC, char* argV[])
    XString xmlFile;
    XString targetVolume;
    bool dosearch = true;
+   bool lazy = false;
    int argInd;
    for (argInd = 1; argInd < argC; argInd++)
    {
@@ -96,6 +100,10 @@ int main(int argC, char* argV[])
 
       if (strcmp(argV[argInd], "-v") == 0)
          dosearch = false;
+      else if (strcmp(argV[argInd], "-g") == 0)
+         setGrammarRebuild(true);
+      else if (strcmp(argV[argInd], "-l") == 0)
+         lazy = true;
       else
          std::cerr
               << "Unknown option \'" << argV[argInd]
@@ -113,12 +121,12 @@ int main(int argC, char* argV[])
 
    if (dosearch)
    {
-      hddsBrowser *browser = new hddsBrowser(xmlFile);
+      hddsBrowser *browser = new hddsBrowser(xmlFile, lazy);
       std::vector<Refsys> *vlist = browser->find(targetVolume);
       for (std::vector<Refsys>::iterator it = vlist->begin();
            it < vlist->end();
            ++it) {
-         std::vector<double> angles = it->getRotation();
+         Refsys::EulerAngles angles = it->getRotation();
          angles[0] *= 180/M_PI;
          angles[1] *= 180/M_PI;
          angles[2] *= 180/M_PI;
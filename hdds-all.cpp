@@ -0,0 +1,235 @@
+/*
+ *  hdds-all :   an interface utility that reads in a HDDS document
+ *                   (Hall D Detector Specification) once and writes out
+ *                   all of the generated geometry sources in one go:
+ *                     - hddsGeant3.F, as written by hdds-geant
+ *                     - hddsroot.C,   as written by hdds-root
+ *                     - hddsroot.h,   as written by hdds-root_h
+ *                   followed by the geometry md5 checksum, as printed
+ *                   by hdds-md5.
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Notes:
+ *  ------
+ * 1. The document is parsed and validated once.  Each code writer then
+ *    runs in a child process forked from the parser, so the children
+ *    share the parsed document with the parent without copying it and
+ *    the three translations run side by side on separate cpus.  The
+ *    processes are there for the concurrency only: every writer numbers
+ *    its materials, media, rotations and volumes in its own
+ *    TranslationContext, so the three could also run one after the other
+ *    in this process, and each output is byte-for-byte identical to what
+ *    the single utility writes.
+ * 2. The name of the ROOT macro follows the same rules as hdds-root, so
+ *    main_HDDS.xml produces hddsroot.C.
+ * 3. As a by-product of using the DOM parser to access the xml source,
+ *    hdds-all verifies the source against the schema before translating it.
+ *    Therefore it may also be used as a validator of the xml specification
+ *    (see the -v option).
+ * 4. Each output file is written through an OutputSink, which leaves the
+ *    file and its time stamp alone when the new content is identical, so
+ *    an unchanged geometry does not trigger downstream rebuilds.
+ */
+
+#define APP_NAME "hdds-all"
+
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/util/XMLStringTokenizer.hpp>
+#include <xercesc/sax/SAXParseException.hpp>
+#include <xercesc/parsers/XercesDOMParser.hpp>
+#include <xercesc/framework/LocalFileFormatTarget.hpp>
+#include <xercesc/dom/DOM.hpp>
+#include <xercesc/util/XercesDefs.hpp>
+#include <xercesc/sax/ErrorHandler.hpp>
+
+using namespace xercesc;
+
+#include "XString.hpp"
+#include "XParsers.hpp"
+#include "hddsCommon.hpp"
+#include "hddsOutput.hpp"
+#include "hddsFortranWriter.hpp"
+#include "hddsRootWriter.hpp"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define X(str) XName(str)
+#define S(str) str.c_str()
+
+void usage()
+{
+    std::cerr
+         << "Usage:    " << APP_NAME << " [-v] [-g] [-o {directory}] {HDDS file}"
+         << std::endl <<  "Options:" << std::endl
+         << "    -v   validate only" << std::endl
+         << "    -g   recompile the cached schema grammar" << std::endl
+         << "    -o   write the generated sources into {directory}"
+         << std::endl;
+}
+
+enum Backend
+{
+   kGeant3,
+   kRootMacro,
+   kRootHeader
+};
+
+// Runs one code writer in a child process that writes its output to
+// outFile, and returns the process id of the child.
+
+pid_t spawnWriter(Backend backend, DOMElement* rootEl,
+                  const XString& xmlFile, const std::string& outFile)
+{
+   std::cout.flush();
+   fflush(stdout);
+   pid_t pid = fork();
+   if (pid != 0)
+   {
+      return pid;
+   }
+
+   OutputSink sink(outFile);
+   sink.startPipeline();
+   if (backend == kGeant3)
+   {
+      FortranWriter fout;
+      fout.setOutput(sink.stream());
+      fout.translate(rootEl);
+   }
+   else if (backend == kRootMacro)
+   {
+      RootMacroWriter fout(RootMacroWriter::macroName(xmlFile));
+      fout.setOutput(sink.stream());
+      fout.translate(rootEl);
+   }
+   else
+   {
+      RootHeaderWriter fout;
+      fout.setOutput(sink.stream());
+      fout.translate(rootEl);
+   }
+   _exit(sink.close()? 0 : 1);
+}
+
+int main(int argC, char* argV[])
+{
+   try
+   {
+      XMLPlatformUtils::Initialize();
+   }
+   catch (const XMLException& toCatch)
+   {
+      XString message(toCatch.getMessage());
+      std::cerr
+           << APP_NAME << " - error during initialization!"
+           << std::endl << S(message) << std::endl;
+      return 1;
+   }
+
+   if (argC < 2)
+   {
+      usage();
+      return 1;
+   }
+   else if ((argC == 2) && (strcmp(argV[1], "-?") == 0))
+   {
+      usage();
+      return 2;
+   }
+
+   XString xmlFile;
+   std::string outDir(".");
+   bool allOutput = true;
+   int argInd;
+   for (argInd = 1; argInd < argC; argInd++)
+   {
+      if (argV[argInd][0] != '-')
+         break;
+
+      if (strcmp(argV[argInd], "-v") == 0)
+         allOutput = false;
+      else if (strcmp(argV[argInd], "-g") == 0)
+         setGrammarRebuild(true);
+      else if (strcmp(argV[argInd], "-o") == 0 && argInd + 1 < argC)
+         outDir = argV[++argInd];
+      else
+         std::cerr
+              << "Unknown option \'" << argV[argInd]
+              << "\', ignoring it\n" << std::endl;
+   }
+
+   if (argInd != argC - 1)
+   {
+      usage();
+      return 1;
+   }
+   xmlFile = argV[argInd];
+
+   DOMDocument* document = buildDOMDocument(xmlFile,false);
+   if (document == 0)
+   {
+      std::cerr
+           << APP_NAME << " - error parsing HDDS document, "
+           << "cannot continue" << std::endl;
+      return 1;
+   }
+
+   DOMElement* rootEl = loadElementById(document, "everything");
+   if (rootEl == 0)
+   {
+      std::cerr
+           << APP_NAME << " - error scanning HDDS document, " << std::endl
+           << "  no element named \"everything\" found" << std::endl;
+      return 1;
+   }
+
+   int status = 0;
+   if (allOutput)
+   {
+      std::vector<std::string> outFiles;
+      outFiles.push_back(outDir + "/hddsGeant3.F");
+      outFiles.push_back(outDir + "/" +
+                         RootMacroWriter::macroName(xmlFile) + ".C");
+      outFiles.push_back(outDir + "/hddsroot.h");
+
+      std::vector<pid_t> children;
+      children.push_back(spawnWriter(kGeant3, rootEl, xmlFile, outFiles[0]));
+      children.push_back(spawnWriter(kRootMacro, rootEl, xmlFile, outFiles[1]));
+      children.push_back(spawnWriter(kRootHeader, rootEl, xmlFile, outFiles[2]));
+
+      for (unsigned int i = 0; i < children.size(); i++)
+      {
+         int childStatus = 1;
+         if (children[i] < 0 ||
+             waitpid(children[i], &childStatus, 0) != children[i] ||
+             !WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0)
+         {
+            std::cerr
+                 << APP_NAME << " - error writing " << outFiles[i]
+                 << ", output removed" << std::endl;
+            remove(outFiles[i].c_str());
+            status = 1;
+         }
+      }
+   }
+
+   std::cout << "HDDS Geometry MD5 Checksum: " << last_md5_checksum << std::endl;
+
+   XMLPlatformUtils::Terminate();
+   return status;
+}
@@ -0,0 +1,342 @@
+/*
+ *  hdds-fieldmap :   an interface utility that reads in a HDDS document
+ *                   (Hall D Detector Specification) and converts the
+ *                   plain-text field map of one of its mappedBfield
+ *                   regions into the binary bricked or octree encoding.
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Notes:
+ *  ------
+ * 1. The size of the grid and the nesting order of the values in the
+ *    text map are taken from the first grid element of the mappedBfield
+ *    in the named region, and the text map is read by FieldGrid, as the
+ *    FieldEngine reads it.  The text map is expected to hold one triplet
+ *    of field components per grid point and nothing else.
+ * 2. The binary map is read back and compared with the text map after it
+ *    has been written, site by site, before the utility reports success.
+ *    At the reduced precisions chosen with -p the two are not expected
+ *    to agree exactly; instead the largest error at any site, and the
+ *    largest error of the interpolated field at the sites and at the
+ *    centres of the cells, are reported against the text map, in the
+ *    field units of the map and as a fraction of its largest component.
+ * 3. With -t the map is written in the octree encoding instead, built to
+ *    reproduce every site of the text map to within the given tolerance.
+ *    The size of the tree is reported, together with the largest error
+ *    at the sites and at the centres of the cells, the latter measured
+ *    against trilinear interpolation of the full text map.
+ * 4. To use the binary map, point the map attribute of the mappedBfield at
+ *    the new file and change its encoding to "bricked" or "octree".
+ */
+
+#define APP_NAME "hdds-fieldmap"
+
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/dom/DOM.hpp>
+#include <xercesc/util/XercesDefs.hpp>
+
+using namespace xercesc;
+
+#include "XString.hpp"
+#include "XParsers.hpp"
+#include "hddsCommon.hpp"
+#include "hddsField.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define X(str) XName(str)
+#define S(str) str.c_str()
+
+void usage()
+{
+    std::cerr
+         << "Usage:    " << APP_NAME << " [-b {brick}] [-p {precision}]"
+         << " [-t {tolerance}]" << std::endl
+         << "              {HDDS file} {region} {text map} {binary map}"
+         << std::endl <<  "Options:" << std::endl
+         << "    -b   samples along the edge of a brick, a power of 2"
+         << " (default " << BrickedFieldMap::kDefaultBrick << ")"
+         << std::endl
+         << "    -p   storage of the components, float, int16 or half"
+         << " (default float)"
+         << std::endl
+         << "    -t   write an octree map, with this largest error at a site"
+         << " in the units of the map"
+         << std::endl;
+}
+
+int writeOctree(const std::string& binFile, const std::vector<float>& values,
+                const int nsites[3], float tolerance)
+{
+   if (! OctreeFieldMap::write(binFile, &values[0], nsites, tolerance))
+   {
+      return 1;
+   }
+   OctreeFieldMap omap;
+   if (! omap.open(binFile))
+   {
+      return 1;
+   }
+
+   double siteErr = 0;
+   double cellErr = 0;
+   int i[3];
+   for (i[2] = 0; i[2] < nsites[2]; ++i[2])
+   {
+      for (i[1] = 0; i[1] < nsites[1]; ++i[1])
+      {
+         for (i[0] = 0; i[0] < nsites[0]; ++i[0])
+         {
+            for (int centre = 0; centre < 2; ++centre)
+            {
+               float x[3];
+               for (int ax = 0; ax < 3; ++ax)
+               {
+                  x[ax] = i[ax] + ((i[ax] < nsites[ax] - 1)? 0.5f * centre
+                                                           : 0);
+               }
+               float Boct[3], Bref[3];
+               omap.interpolateSite(x, Boct);
+               OctreeFieldMap::interpolate(&values[0], nsites, x, Bref);
+               for (int c = 0; c < 3; ++c)
+               {
+                  double err = fabs(Boct[c] - Bref[c]);
+                  double& maxErr = (centre)? cellErr : siteErr;
+                  maxErr = (err > maxErr)? err : maxErr;
+               }
+            }
+         }
+      }
+   }
+
+   size_t dense = values.size() * sizeof(float);
+   size_t size = (omap.getNodeCount() + (size_t)nsites[1] * nsites[2] + 1)
+                 * sizeof(int)
+               + omap.getVertexCount() * (sizeof(int) + 3 * sizeof(float));
+   std::cout
+        << "Wrote " << nsites[0] << "x" << nsites[1] << "x" << nsites[2]
+        << " sites to " << binFile << " as an octree of "
+        << omap.getNodeCount() << " nodes, " << omap.getLeafCount()
+        << " leaves and " << omap.getVertexCount() << " vertices" << std::endl
+        << "  " << size << " bytes of field data, "
+        << (double)size / dense << " of the dense map" << std::endl
+        << "  max site error        " << siteErr
+        << " (tolerance " << tolerance << ")" << std::endl
+        << "  max cell centre error " << cellErr << std::endl;
+   return 0;
+}
+
+void reportErrors(const BrickedFieldMap& bmap,
+                  const std::vector<float>& values)
+{
+   // compares the sites and the interpolated field of bmap with values
+   const int* nsites = bmap.getSites();
+   float maxB = 0;
+   for (unsigned int i = 0; i < values.size(); ++i)
+   {
+      maxB = (fabs(values[i]) > maxB)? fabs(values[i]) : maxB;
+   }
+   double siteErr = 0;
+   double interpErr = 0;
+   int i[3];
+   for (i[2] = 0; i[2] < nsites[2]; ++i[2])
+   {
+      for (i[1] = 0; i[1] < nsites[1]; ++i[1])
+      {
+         for (i[0] = 0; i[0] < nsites[0]; ++i[0])
+         {
+            float b[3];
+            bmap.get(i[0], i[1], i[2], b);
+            const float* v = &values[(((size_t)i[2] * nsites[1] + i[1])
+                                      * nsites[0] + i[0]) * 3];
+            for (int c = 0; c < 3; ++c)
+            {
+               double err = fabs(b[c] - v[c]);
+               siteErr = (err > siteErr)? err : siteErr;
+            }
+
+            for (int centre = 0; centre < 2; ++centre)
+            {
+               float u[3];
+               for (int ax = 0; ax < 3; ++ax)
+               {
+                  int cells = nsites[ax] - 1;
+                  u[ax] = (cells == 0)? 0 :
+                          (i[ax] + ((i[ax] < cells)? 0.5f * centre : 0))
+                          / cells;
+               }
+               float Bbin[3], Bref[3];
+               bmap.interpolate(u, Bbin);
+               BrickedFieldMap::interpolate(&values[0], nsites, u, Bref);
+               for (int c = 0; c < 3; ++c)
+               {
+                  double err = fabs(Bbin[c] - Bref[c]);
+                  interpErr = (err > interpErr)? err : interpErr;
+               }
+            }
+         }
+      }
+   }
+   std::cout
+        << "Stored as " << BrickedFieldMap::getPrecisionName(
+                              bmap.getPrecision())
+        << ", largest field component " << maxB << std::endl
+        << "  max site error          " << siteErr << " ("
+        << ((maxB > 0)? siteErr / maxB : 0) << " of the largest)" << std::endl
+        << "  max interpolation error " << interpErr << " ("
+        << ((maxB > 0)? interpErr / maxB : 0) << " of the largest)"
+        << std::endl;
+}
+
+int main(int argC, char* argV[])
+{
+   try
+   {
+      XMLPlatformUtils::Initialize();
+   }
+   catch (const XMLException& toCatch)
+   {
+      XString message(toCatch.getMessage());
+      std::cerr
+           << APP_NAME << " - error during initialization!"
+           << std::endl << S(message) << std::endl;
+      return 1;
+   }
+
+   int brick = BrickedFieldMap::kDefaultBrick;
+   BrickedFieldMap::Precision precision = BrickedFieldMap::kFloat;
+   float tolerance = -1;
+   int argInd;
+   for (argInd = 1; argInd < argC; argInd++)
+   {
+      if (argV[argInd][0] != '-')
+         break;
+
+      if (strcmp(argV[argInd], "-b") == 0 && argInd + 1 < argC)
+         brick = atoi(argV[++argInd]);
+      else if (strcmp(argV[argInd], "-p") == 0 && argInd + 1 < argC)
+      {
+         std::string precS(argV[++argInd]);
+         if (precS == "int16")
+            precision = BrickedFieldMap::kInt16;
+         else if (precS == "half")
+            precision = BrickedFieldMap::kHalf;
+         else if (precS != "float")
+         {
+            usage();
+            return 1;
+         }
+      }
+      else if (strcmp(argV[argInd], "-t") == 0 && argInd + 1 < argC)
+         tolerance = atof(argV[++argInd]);
+      else
+         std::cerr
+              << "Unknown option \'" << argV[argInd]
+              << "\', ignoring it\n" << std::endl;
+   }
+
+   if (argInd != argC - 4)
+   {
+      usage();
+      return 1;
+   }
+   XString xmlFile = argV[argInd];
+   XString regionS = argV[argInd + 1];
+   std::string textFile(argV[argInd + 2]);
+   std::string binFile(argV[argInd + 3]);
+
+   DOMDocument* document = buildDOMDocument(xmlFile,false);
+   if (document == 0)
+   {
+      std::cerr
+           << APP_NAME << " - error parsing HDDS document, "
+           << "cannot continue" << std::endl;
+      return 1;
+   }
+
+   DOMElement* regionEl = loadElementById(document, regionS);
+   DOMNodeList* mapfL = (regionEl == 0)? 0 :
+                        regionEl->getElementsByTagName(X("mappedBfield"));
+   if (mapfL == 0 || mapfL->getLength() == 0)
+   {
+      std::cerr
+           << APP_NAME << " - error scanning HDDS document, " << std::endl
+           << "  no region named \"" << regionS << "\" with a"
+           << " mappedBfield found" << std::endl;
+      return 1;
+   }
+
+   std::vector<FieldGrid> grids;
+   std::vector<float> values;
+   std::string error;
+   if (! FieldGrid::read((DOMElement*)mapfL->item(0), grids, error) ||
+       ! grids[0].readText(textFile, values, error))
+   {
+      std::cerr << APP_NAME << " error: " << error << std::endl;
+      return 1;
+   }
+   const int* nsites = grids[0].nsites;
+
+   if (tolerance >= 0)
+   {
+      int status = writeOctree(binFile, values, nsites, tolerance);
+      releaseInputDocument();
+      XMLPlatformUtils::Terminate();
+      return status;
+   }
+
+   if (! BrickedFieldMap::write(binFile, &values[0], nsites, brick,
+                                precision))
+   {
+      return 1;
+   }
+
+   BrickedFieldMap bmap;
+   if (! bmap.open(binFile))
+   {
+      return 1;
+   }
+   if (precision != BrickedFieldMap::kFloat)
+   {
+      reportErrors(bmap, values);
+   }
+   for (int i3 = 0; precision == BrickedFieldMap::kFloat &&
+                    i3 < nsites[2]; ++i3)
+   {
+      for (int i2 = 0; i2 < nsites[1]; ++i2)
+      {
+         for (int i1 = 0; i1 < nsites[0]; ++i1)
+         {
+            float b[3];
+            bmap.get(i1, i2, i3, b);
+            const float* v = &values[(((size_t)i3 * nsites[1] + i2)
+                                      * nsites[0] + i1) * 3];
+            if (b[0] != v[0] || b[1] != v[1] || b[2] != v[2])
+            {
+               std::cerr
+                    << APP_NAME << " error: " << binFile
+                    << " does not read back correctly at site "
+                    << i1 + 1 << "," << i2 + 1 << "," << i3 + 1
+                    << std::endl;
+               return 1;
+            }
+         }
+      }
+   }
+
+   std::cout
+        << "Wrote " << nsites[0] << "x" << nsites[1] << "x" << nsites[2]
+        << " sites of region " << regionS << " to " << binFile
+        << " in bricks of " << brick << "^3 sites" << std::endl;
+
+   releaseInputDocument();
+   XMLPlatformUtils::Terminate();
+   return 0;
+}
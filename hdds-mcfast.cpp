@@ -13,7 +13,8 @@
  *    standard DOM-1 interface.
  * 3. The code has been tested with the xerces-c DOM implementation from
  *    Apache, and is intended to be used with the xerces-c library.
- * 4. Output is sent to standard out through the ordinary c++ i/o library.
+ * 4. Output is sent to standard out, or to the file named with -o, through
+ *    an OutputSink that only replaces the file if its content changes.
  * 5. Within the HDDS document are references to mcfast db files that list
  *    the variables required on each output line.  These are looked for
  *    starting from the current working directory, and are typically given
@@ -36,6 +37,7 @@
 
 #include "XString.hpp"
 #include "XParsers.hpp"
+#include "hddsOutput.hpp"
 
 #include <assert.h>
 #include <string.h>
@@ -132,9 +134,10 @@ makeTargetTable targetTable;
 void usage()
 {
     cerr << "\nUsage:\n"
-            "    hdds-mcfast [-v] {HDDS file}\n\n"
+            "    hdds-mcfast [-v] [-o {output file}] {HDDS file}\n\n"
             "Options:\n"
             "    -v   validate only\n"
+            "    -o   write to {output file} if its content changes\n"
          << endl;
 }
 
@@ -148,7 +151,7 @@ class DbMaker
    static void processTemplateFile(const DOMElement* const targetEl,
                                             const char* const fname);
    static void makedb(DOMElement* el);
-   static void printdb();
+   static void printdb(ostream& out);
 };
 
 int main(int argC, char* argV[])
@@ -178,6 +181,7 @@ int main(int argC, char* argV[])
 
    const char*  xmlFile = 0;
    bool mcfastOutput = true;
+   string outFile("-");
    int argInd;
    for (argInd = 1; argInd < argC; argInd++)
    {
@@ -186,6 +190,8 @@ int main(int argC, char* argV[])
 
       if (strcmp(argV[argInd],"-v") == 0)
          mcfastOutput = false;
+      else if (strcmp(argV[argInd],"-o") == 0 && argInd + 1 < argC)
+         outFile = argV[++argInd];
       else
          cerr << "Unknown option '" << argV[argInd]
               << "', ignoring it\n" << endl;
@@ -248,7 +254,12 @@ int main(int argC, char* argV[])
             << "make HitsOnTrack 4 0 0" << endl;
    modelTable["hitsontrack"] = entry;      // last comes histontrack
 
-   DbMaker::printdb();
+   OutputSink sink(outFile);
+   DbMaker::printdb(sink.stream());
+   if (! sink.close())
+   {
+      return 1;
+   }
 
    XMLPlatformUtils::Terminate();
    return 0;
@@ -1522,7 +1533,7 @@ void DbMaker::makedb(DOMElement* el)
    }
 }
 
-void DbMaker::printdb()
+void DbMaker::printdb(ostream& out)
 {
    char line[999];
    std::map<const std::string,modelTableEntry>::iterator iter;
@@ -1534,8 +1545,8 @@ void DbMaker::printdb()
       while (! idb.eof())
       {
          idb.getline(line,999);
-         cout << line << endl;
+         out << line << endl;
       }
    }
-   cout << "end" << endl;
+   out << "end" << endl;
 }
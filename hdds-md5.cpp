@@ -39,6 +39,7 @@ using namespace xercesc;
 #include "XString.hpp"
 #include "XParsers.hpp"
 #include "hddsCommon.hpp"
+#include "hddsCache.hpp"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -55,15 +56,16 @@ using namespace xercesc;
 #include <list>
 #include <map>
 
-#define X(str) XString(str).unicode_str()
+#define X(str) XName(str)
 #define S(str) str.c_str()
 
 void usage()
 {
     std::cerr
-         << "Usage:    " << APP_NAME << " [-v] {HDDS file}"
+         << "Usage:    " << APP_NAME << " [-v] [-g] {HDDS file}"
          << std::endl <<  "Options:" << std::endl
-         << "    -v   validate only" << std::endl;
+         << "    -v   validate only" << std::endl
+         << "    -g   recompile the cached schema grammar" << std::endl;
 }
 
 
@@ -95,13 +97,16 @@ int main(int argC, char* argV[])
    }
 
    XString xmlFile;
+   bool rebuildGrammar = false;
    int argInd;
    for (argInd = 1; argInd < argC; argInd++)
    {
       if (argV[argInd][0] != '-')
          break;
 
-      if ( ! (strcmp(argV[argInd], "-v") == 0))
+      if (strcmp(argV[argInd], "-g") == 0)
+         rebuildGrammar = true;
+      else if ( ! (strcmp(argV[argInd], "-v") == 0))
          std::cerr
               << "Unknown option \'" << argV[argInd]
               << "\', ignoring it\n" << std::endl;
@@ -114,10 +119,24 @@ int main(int argC, char* argV[])
    }
    xmlFile = argV[argInd];
 
-	// Parse the XML input file, calculating the checksum at the end
-	// and leaving it in the global variable "last_md5_checksum"
-	//DOMDocument* document =  // commented out to avoid compiler warnings
-	parseInputDocument(xmlFile,false);
+	// A current geometry cache already holds the checksum of the files
+	// it was compiled from, verified against their present contents.
+	// Otherwise parse the XML input file, calculating the checksum at
+	// the end and leaving it in the global variable "last_md5_checksum"
+	// A grammar rebuild needs the parse, so it bypasses the cache.
+	GeometryCache cache;
+	setGrammarRebuild(rebuildGrammar);
+	if (rebuildGrammar || ! cache.load(xmlFile))
+	{
+		DOMDocument* document = parseInputDocument(xmlFile,false);
+		DOMElement* rootEl = (document == 0)? 0 :
+		                     loadElementById(document, "everything");
+		if (rootEl != 0)
+		{
+			cache.compile(rootEl);
+			cache.save(xmlFile);
+		}
+	}
 	
 	std::cout << "HDDS Geometry MD5 Checksum: " << last_md5_checksum << std::endl;
 	
@@ -0,0 +1,177 @@
+/*
+ *  hdds-output-check :   a consistency check of the formatter pipeline
+ *                   of OutputSink, which writes the same sequence of
+ *                   numbers and text through a pipelined OutputSink and
+ *                   through a plain std::ostringstream and compares the
+ *                   two results byte by byte.
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Notes:
+ *  ------
+ * 1. The sequence covers the stream state that the pipeline has to carry
+ *    over to the formatter thread: widths and fills with every kind of
+ *    adjustment, decimal, octal and hex bases with showbase and uppercase,
+ *    showpos, fixed, scientific and default floating point at several
+ *    precisions, and the types that are deferred (long, unsigned long,
+ *    double and everything promoted to them) next to the ones that are
+ *    formatted in place (bool, long double, pointers, characters).
+ * 2. The sequence is repeated with -n until the queued blocks have gone
+ *    around the ring many times, and part of it is written while the
+ *    stream is attached to another streambuf.
+ * 3. On a machine with a single cpu startPipeline() declines and the
+ *    check only covers the unpipelined sink.
+ */
+
+#define APP_NAME "hdds-output-check"
+
+#include "hddsOutput.hpp"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+void usage()
+{
+    std::cerr
+         << "Usage:    " << APP_NAME << " [-n {passes}] [-o {scratch file}]"
+         << std::endl <<  "Options:" << std::endl
+         << "    -n   number of passes over the sequence (default 2000)"
+         << std::endl
+         << "    -o   scratch file for the sink output (default in /tmp)"
+         << std::endl;
+}
+
+void writeSequence(std::ostream& out, int pass)
+{
+   static const std::ios_base::fmtflags adjust[3] = {
+      std::ios_base::left, std::ios_base::right, std::ios_base::internal
+   };
+   static const std::ios_base::fmtflags base[3] = {
+      std::ios_base::dec, std::ios_base::oct, std::ios_base::hex
+   };
+   static const std::ios_base::fmtflags floating[3] = {
+      std::ios_base::fmtflags(0), std::ios_base::fixed,
+      std::ios_base::scientific
+   };
+   static const char fills[3] = {' ', '0', '*'};
+
+   long lv = (pass % 2)? -(long)pass * 7919 : (long)pass * 104729;
+   unsigned long uv = (unsigned long)pass * 2654435761UL;
+   double dv = (pass - 1000) * 3.14159265358979 / 7;
+   for (int i = 0; i < 3; i++)
+   {
+      out.flags(adjust[i] | base[(pass + i) % 3]);
+      out.fill(fills[(pass + i) % 3]);
+      out << "[" << std::setw(12) << lv << "|" << std::setw(i * 4) << uv
+          << "|" << (int)pass << "|" << (short)-pass
+          << "|" << (unsigned int)pass << "]";
+      out << std::showbase << std::setw(14) << lv << " "
+          << std::uppercase << uv << std::noshowbase << std::nouppercase
+          << " " << std::showpos << std::setw(9) << lv << std::noshowpos
+          << std::endl;
+
+      out.flags(adjust[i] | floating[(pass + i) % 3]);
+      for (int prec = 0; prec < 18; prec += 5)
+      {
+         out << std::setprecision(prec) << std::setw(prec + 8) << dv
+             << " " << (float)dv << " " << dv * 1e-12 << " " << dv * 1e17;
+      }
+      out << std::showpoint << std::showpos << std::setw(16) << 1.0
+          << std::noshowpoint << std::noshowpos << std::endl;
+   }
+   out.flags(std::ios_base::dec | std::ios_base::right);
+   out.precision(6);
+   out.fill(' ');
+   out << true << " " << std::boolalpha << false << std::noboolalpha
+       << " " << (long double)dv << " " << std::setw(5) << 'c'
+       << " " << std::setw(7) << "text" << std::endl;
+}
+
+int main(int argC, char* argV[])
+{
+   int passes = 2000;
+   std::string scratch;
+   for (int argInd = 1; argInd < argC; argInd++)
+   {
+      if (strcmp(argV[argInd], "-n") == 0 && argInd + 1 < argC)
+         passes = atoi(argV[++argInd]);
+      else if (strcmp(argV[argInd], "-o") == 0 && argInd + 1 < argC)
+         scratch = argV[++argInd];
+      else
+      {
+         usage();
+         return 1;
+      }
+   }
+   if (scratch.size() == 0)
+   {
+      std::stringstream tmpStr;
+      tmpStr << "/tmp/" << APP_NAME << "." << getpid();
+      scratch = tmpStr.str();
+   }
+
+   std::ostringstream expected;
+   OutputSink sink(scratch, OutputSink::kNone);
+   bool pipelined = sink.startPipeline();
+   std::ostream& out = sink.stream();
+   std::ostringstream aside;
+   for (int pass = 0; pass < passes; pass++)
+   {
+      writeSequence(expected, pass);
+      if (pass % 97 == 13)
+      {
+         // numbers written while the stream is attached elsewhere are
+         // formatted in place and must not be queued
+         std::streambuf* buf = out.rdbuf(aside.rdbuf());
+         writeSequence(out, pass);
+         out.rdbuf(buf);
+         out << aside.str();
+         aside.str("");
+      }
+      else
+      {
+         writeSequence(out, pass);
+      }
+   }
+   if (! sink.close())
+   {
+      return 1;
+   }
+
+   std::ifstream fin(scratch.c_str());
+   std::stringstream content;
+   content << fin.rdbuf();
+   fin.close();
+   remove(scratch.c_str());
+
+   std::string got(content.str());
+   std::string want(expected.str());
+   if (got != want)
+   {
+      size_t pos = 0;
+      while (pos < got.size() && pos < want.size() && got[pos] == want[pos])
+      {
+         ++pos;
+      }
+      size_t line = pos - ((pos > 40)? 40 : pos);
+      std::cerr
+           << APP_NAME << " error: output differs at byte " << pos
+           << std::endl << "expected: " << want.substr(line, 80)
+           << std::endl << "got:      " << got.substr(line, 80)
+           << std::endl;
+      return 1;
+   }
+   std::cout
+        << APP_NAME << ": " << want.size() << " bytes in " << passes
+        << " passes match, " << (pipelined? "pipelined" : "not pipelined")
+        << std::endl;
+   return 0;
+}
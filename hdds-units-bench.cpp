@@ -0,0 +1,170 @@
+/*
+ *  hdds-units-bench :   a microbenchmark that reads in a HDDS document
+ *                   (Hall D Detector Specification) and measures the
+ *                   cost of looking up the unit conversions of its
+ *                   elements.
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Notes:
+ *  ------
+ * 1. Two ways of getting the units are timed over every element in the
+ *    document, repeated as many times as requested with -n:
+ *      per call : Units unit; unit.getConversions(el);
+ *                 the pattern used by the translators up to now, which
+ *                 reads and transcodes the unit attributes every time;
+ *      cached   : Units::forElement(el);
+ *                 the per-element cache the translators use now.
+ *    The per-call loop only uses the long-standing interface, so the
+ *    same loop built against an older hddsCommon gives the figure for
+ *    the original if-chain.
+ * 2. Elements inside <parameters> and <mcfast> are left out, their
+ *    unit attributes name quantities other than lengths and angles.
+ * 3. Results are reported as wall clock nanoseconds per lookup.
+ */
+
+#define APP_NAME "hdds-units-bench"
+
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/dom/DOM.hpp>
+#include <xercesc/util/XercesDefs.hpp>
+
+using namespace xercesc;
+
+#include "XString.hpp"
+#include "XParsers.hpp"
+#include "hddsCommon.hpp"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <iostream>
+#include <vector>
+
+#define X(str) XName(str)
+#define S(str) str.c_str()
+
+void usage()
+{
+    std::cerr
+         << "Usage:    " << APP_NAME << " [-n {passes}] {HDDS file}"
+         << std::endl <<  "Options:" << std::endl
+         << "    -n   number of passes over the document (default 100)"
+         << std::endl;
+}
+
+double wallClock()
+{
+   struct timeval now;
+   gettimeofday(&now, 0);
+   return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+int main(int argC, char* argV[])
+{
+   try
+   {
+      XMLPlatformUtils::Initialize();
+   }
+   catch (const XMLException& toCatch)
+   {
+      XString message(toCatch.getMessage());
+      std::cerr
+           << APP_NAME << " - error during initialization!"
+           << std::endl << S(message) << std::endl;
+      return 1;
+   }
+
+   int passes = 100;
+   int argInd;
+   for (argInd = 1; argInd < argC; argInd++)
+   {
+      if (argV[argInd][0] != '-')
+         break;
+
+      if (strcmp(argV[argInd], "-n") == 0 && argInd + 1 < argC)
+         passes = atoi(argV[++argInd]);
+      else
+         std::cerr
+              << "Unknown option \'" << argV[argInd]
+              << "\', ignoring it\n" << std::endl;
+   }
+
+   if (argInd != argC - 1 || passes <= 0)
+   {
+      usage();
+      return 1;
+   }
+   XString xmlFile = argV[argInd];
+
+   DOMDocument* document = buildDOMDocument(xmlFile,false);
+   if (document == 0)
+   {
+      std::cerr
+           << APP_NAME << " - error parsing HDDS document, "
+           << "cannot continue" << std::endl;
+      return 1;
+   }
+
+   std::vector<DOMElement*> elements;
+   DOMNodeList* elementL = document->getElementsByTagName(X("*"));
+   for (unsigned int i = 0; i < elementL->getLength(); ++i)
+   {
+      // parameter definitions carry units that are not lengths or angles
+      bool skip = false;
+      DOMNode* node = elementL->item(i);
+      for (; node && node->getNodeType() == DOMNode::ELEMENT_NODE;
+           node = node->getParentNode())
+      {
+         XString tagS(((DOMElement*)node)->getTagName());
+         if (tagS == "parameters" || tagS == "mcfast")
+         {
+            skip = true;
+            break;
+         }
+      }
+      if (! skip)
+      {
+         elements.push_back((DOMElement*)elementL->item(i));
+      }
+   }
+
+   double sum[2] = {0, 0};
+   double start = wallClock();
+   for (int pass = 0; pass < passes; ++pass)
+   {
+      for (unsigned int i = 0; i < elements.size(); ++i)
+      {
+         Units unit;
+         unit.getConversions(elements[i]);
+         sum[0] += unit.cm;
+      }
+   }
+   double perCall = wallClock() - start;
+
+   start = wallClock();
+   for (int pass = 0; pass < passes; ++pass)
+   {
+      for (unsigned int i = 0; i < elements.size(); ++i)
+      {
+         sum[1] += Units::forElement(elements[i]).cm;
+      }
+   }
+   double cached = wallClock() - start;
+
+   double lookups = (double)passes * elements.size();
+   printf("%d elements, %d passes\n", (int)elements.size(), passes);
+   printf("per call : %10.1f ns/lookup\n", perCall / lookups * 1e9);
+   printf("cached   : %10.1f ns/lookup\n", cached / lookups * 1e9);
+   if (sum[0] != sum[1])
+   {
+      printf("the two loops disagree: %g != %g\n", sum[0], sum[1]);
+   }
+
+   releaseInputDocument();
+   XMLPlatformUtils::Terminate();
+   return 0;
+}
@@ -26,6 +26,7 @@ using namespace xercesc;
 #include "XString.hpp"
 #include "XParsers.hpp"
 #include "hddsCommon.hpp"
+#include "hddsCache.hpp"
 
 class hddsBrowser
 {
@@ -33,12 +34,18 @@ class hddsBrowser
   * geometry information in the hdds geometry tree.
   */
  public:
-   hddsBrowser(const XString xmlFile);	// constructor from xml document
+   hddsBrowser(const XString xmlFile,	// constructor from xml document,
+               bool lazy = false);	// parsing detector files on demand
+   ~hddsBrowser();
    std::vector<Refsys>* find(const XString volume, const Refsys *ref = 0,
                              const DOMElement *contEl = 0);
                                    	// look up a volume in the geometry
  private:
-   DOMDocument *fGeomDoc;		// the geometry tree document
+   GeometryCache *fCache;		// the flattened geometry model
+   DOMDocument *fDocument;		// lazily loaded document, or 0
+
+   hddsBrowser(const hddsBrowser&);
+   void operator=(const hddsBrowser&);
 };
 
 #endif
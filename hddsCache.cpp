@@ -0,0 +1,416 @@
+/*  HDDS Geometry Cache
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Implementation Notes:
+ *  ---------------------
+ * 1. The cache file is a flat binary image in the byte order of the host
+ *    that wrote it.  It starts with a magic string and a format version,
+ *    followed by the MD5 checksum and the list of xml files that were fed
+ *    to the parser, in the order that MyEntityResolver saw them.  A reader
+ *    recomputes the checksum over that list before it trusts anything else
+ *    in the file.  Any change to an included file, or to the top-level file
+ *    that names the includes, changes the checksum.
+ * 2. The placement arrays of the GeometryModel are written as contiguous
+ *    blocks, one per array, so reading them back is a handful of large
+ *    reads rather than a loop over the placements.
+ * 3. The cache is written to a temporary file first and then renamed into
+ *    place, so concurrent jobs never see a partially written cache.  By
+ *    default it sits next to the top-level xml file; set HDDS_CACHE_DIR to
+ *    put it somewhere else, or to "none" to disable caching altogether.
+ */
+
+#include "XString.hpp"
+#include "XParsers.hpp"
+#include "hddsCache.hpp"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define APP_NAME "hddsCache"
+
+#define X(str) XName(str)
+#define S(str) str.c_str()
+
+#define HDDS_CACHE_MAGIC "HDDScache"
+#define HDDS_CACHE_VERSION 2
+
+static void putInt(std::ostream& ofs, int value)
+{
+   ofs.write((const char*)&value, sizeof(int));
+}
+
+static void putDouble(std::ostream& ofs, double value)
+{
+   ofs.write((const char*)&value, sizeof(double));
+}
+
+static void putString(std::ostream& ofs, const std::string& str)
+{
+   putInt(ofs, str.size());
+   ofs.write(str.data(), str.size());
+}
+
+static void putAttributes(std::ostream& ofs,
+                          const GeometryModel::AttributeList& attrs)
+{
+   putInt(ofs, attrs.size());
+   GeometryModel::AttributeList::const_iterator iter;
+   for (iter = attrs.begin(); iter != attrs.end(); ++iter)
+   {
+      putString(ofs, iter->first);
+      putString(ofs, iter->second);
+   }
+}
+
+static int getInt(std::istream& ifs)
+{
+   int value = 0;
+   ifs.read((char*)&value, sizeof(int));
+   return value;
+}
+
+static double getDouble(std::istream& ifs)
+{
+   double value = 0;
+   ifs.read((char*)&value, sizeof(double));
+   return value;
+}
+
+static std::string getString(std::istream& ifs)
+{
+   int len = getInt(ifs);
+   if (len > (1 << 24))
+   {
+      ifs.setstate(std::ios::failbit);
+   }
+   if (len <= 0 || !ifs.good())
+   {
+      return std::string();
+   }
+   std::string str(len, ' ');
+   ifs.read(&str[0], len);
+   return str;
+}
+
+static void getAttributes(std::istream& ifs,
+                          GeometryModel::AttributeList& attrs)
+{
+   int n = getInt(ifs);
+   for (int i = 0; i < n && ifs.good(); i++)
+   {
+      std::string name = getString(ifs);
+      std::string value = getString(ifs);
+      attrs.push_back(std::make_pair(name, value));
+   }
+}
+
+template <class T>
+static void putArray(std::ostream& ofs, const std::vector<T>& array)
+{
+   putInt(ofs, array.size());
+   if (array.size() > 0)
+   {
+      ofs.write((const char*)&array[0], array.size() * sizeof(T));
+   }
+}
+
+template <class T>
+static void getArray(std::istream& ifs, std::vector<T>& array)
+{
+   int n = getInt(ifs);
+   if (n < 0 || n > (1 << 28) || !ifs.good())
+   {
+      ifs.setstate(std::ios::failbit);
+      return;
+   }
+   array.resize(n);
+   if (n > 0)
+   {
+      ifs.read((char*)&array[0], n * sizeof(T));
+   }
+}
+
+/* readHeader:
+ *	Reads the leading part of a cache file and checks that it
+ *	belongs to xmlFile and that none of its sources has changed
+ *	since it was written.
+ */
+
+static bool readHeader(std::istream& ifs, const XString& xmlFile,
+                       std::string& checksum,
+                       std::vector<std::string>& sources)
+{
+   char magic[sizeof(HDDS_CACHE_MAGIC)];
+   ifs.read(magic, sizeof(magic));
+   if (!ifs.good() ||
+       std::string(magic, sizeof(magic)) !=
+       std::string(HDDS_CACHE_MAGIC, sizeof(magic)))
+   {
+      return false;
+   }
+   if (getInt(ifs) != HDDS_CACHE_VERSION ||
+       getInt(ifs) != (int)sizeof(double))
+   {
+      return false;
+   }
+   checksum = getString(ifs);
+   int nsources = getInt(ifs);
+   sources.clear();
+   for (int i = 0; i < nsources && ifs.good(); i++)
+   {
+      sources.push_back(getString(ifs));
+   }
+   if (!ifs.good() || sources.size() == 0 || sources[0] != xmlFile)
+   {
+      return false;
+   }
+   return (computeMD5checksum(sources) == checksum);
+}
+
+GeometryCache::GeometryCache()
+{
+}
+
+std::string GeometryCache::cachePath(const XString& xmlFile)
+{
+   std::string dir;
+   const char* dirEnv = getenv("HDDS_CACHE_DIR");
+   if (dirEnv != 0)
+   {
+      if (std::string(dirEnv) == "none")
+      {
+         return std::string();
+      }
+      dir = std::string(dirEnv) + "/";
+   }
+   else
+   {
+      size_t pos = xmlFile.find_last_of('/');
+      if (pos != std::string::npos)
+      {
+         dir = xmlFile.substr(0,pos) + "/";
+      }
+   }
+   return dir + "." + xmlFile.basename() + ".hddscache";
+}
+
+bool GeometryCache::isCurrent(const XString& xmlFile)
+{
+   std::string path = cachePath(xmlFile);
+   if (path.size() == 0)
+   {
+      return false;
+   }
+   std::ifstream ifs(path.c_str(), std::ios::in | std::ios::binary);
+   if (!ifs.is_open())
+   {
+      return false;
+   }
+   std::string checksum;
+   std::vector<std::string> sources;
+   return readHeader(ifs, xmlFile, checksum, sources);
+}
+
+void GeometryCache::clear()
+{
+   fChecksum.clear();
+   fSources.clear();
+   fModel.clear();
+}
+
+bool GeometryCache::load(const XString& xmlFile)
+{
+   clear();
+   std::string path = cachePath(xmlFile);
+   if (path.size() == 0)
+   {
+      return false;
+   }
+   std::ifstream ifs(path.c_str(), std::ios::in | std::ios::binary);
+   if (!ifs.is_open() || !readHeader(ifs, xmlFile, fChecksum, fSources))
+   {
+      clear();
+      return false;
+   }
+
+   int n = getInt(ifs);
+   for (int i = 0; i < n && ifs.good(); i++)
+   {
+      fModel.fIdentNames.push_back(getString(ifs));
+   }
+
+   n = getInt(ifs);
+   for (int i = 0; i < n && ifs.good(); i++)
+   {
+      GeometryModel::Material mat;
+      mat.name = getString(ifs);
+      mat.a = getDouble(ifs);
+      mat.z = getDouble(ifs);
+      mat.density = getDouble(ifs);
+      mat.radlen = getDouble(ifs);
+      mat.abslen = getDouble(ifs);
+      mat.collen = getDouble(ifs);
+      mat.dedx = getDouble(ifs);
+      fModel.fMaterials.push_back(mat);
+   }
+
+   n = getInt(ifs);
+   for (int i = 0; i < n && ifs.good(); i++)
+   {
+      GeometryModel::Region reg;
+      reg.name = getString(ifs);
+      reg.type = getString(ifs);
+      getAttributes(ifs, reg.attributes);
+      fModel.fRegions.push_back(reg);
+   }
+
+   n = getInt(ifs);
+   for (int i = 0; i < n && ifs.good(); i++)
+   {
+      GeometryModel::Volume vol;
+      vol.name = getString(ifs);
+      vol.tag = getString(ifs);
+      vol.envelope = getString(ifs);
+      vol.material = getInt(ifs);
+      getAttributes(ifs, vol.attributes);
+      fModel.fVolumes.push_back(vol);
+   }
+
+   getArray(ifs, fModel.fParent);
+   getArray(ifs, fModel.fVolume);
+   getArray(ifs, fModel.fRegion);
+   for (int i = 0; i < 3; i++)
+   {
+      getArray(ifs, fModel.fOrigin[i]);
+   }
+   for (int i = 0; i < 9; i++)
+   {
+      getArray(ifs, fModel.fRmatrix[i]);
+   }
+   getArray(ifs, fModel.fIdentStart);
+   getArray(ifs, fModel.fIdentField);
+   getArray(ifs, fModel.fIdentValue);
+
+   char trailer[sizeof(HDDS_CACHE_MAGIC)];
+   ifs.read(trailer, sizeof(trailer));
+   if (!ifs.good() ||
+       std::string(trailer, sizeof(trailer)) !=
+       std::string(HDDS_CACHE_MAGIC, sizeof(trailer)) ||
+       fModel.fIdentStart.size() != fModel.fVolume.size() + 1)
+   {
+      std::cerr
+           << APP_NAME << " warning: cache file " << path
+           << " is truncated or corrupt, ignoring it" << std::endl;
+      clear();
+      return false;
+   }
+
+   fModel.rebuildIndices();
+   last_md5_checksum = fChecksum;
+   last_md5_filenames = fSources;
+   return true;
+}
+
+bool GeometryCache::save(const XString& xmlFile) const
+{
+   std::string path = cachePath(xmlFile);
+   if (path.size() == 0 || fSources.size() == 0)
+   {
+      return false;
+   }
+   std::stringstream tmpStr;
+   tmpStr << path << ".tmp" << getpid();
+   std::string tmpPath(tmpStr.str());
+   std::ofstream ofs(tmpPath.c_str(), std::ios::out | std::ios::binary);
+   if (!ofs.is_open())
+   {
+      return false;
+   }
+
+   ofs.write(HDDS_CACHE_MAGIC, sizeof(HDDS_CACHE_MAGIC));
+   putInt(ofs, HDDS_CACHE_VERSION);
+   putInt(ofs, sizeof(double));
+   putString(ofs, fChecksum);
+   putInt(ofs, fSources.size());
+   for (unsigned int i = 0; i < fSources.size(); i++)
+   {
+      putString(ofs, fSources[i]);
+   }
+
+   putInt(ofs, fModel.fIdentNames.size());
+   for (unsigned int i = 0; i < fModel.fIdentNames.size(); i++)
+   {
+      putString(ofs, fModel.fIdentNames[i]);
+   }
+
+   putInt(ofs, fModel.fMaterials.size());
+   for (unsigned int i = 0; i < fModel.fMaterials.size(); i++)
+   {
+      const GeometryModel::Material& mat = fModel.fMaterials[i];
+      putString(ofs, mat.name);
+      putDouble(ofs, mat.a);
+      putDouble(ofs, mat.z);
+      putDouble(ofs, mat.density);
+      putDouble(ofs, mat.radlen);
+      putDouble(ofs, mat.abslen);
+      putDouble(ofs, mat.collen);
+      putDouble(ofs, mat.dedx);
+   }
+
+   putInt(ofs, fModel.fRegions.size());
+   for (unsigned int i = 0; i < fModel.fRegions.size(); i++)
+   {
+      putString(ofs, fModel.fRegions[i].name);
+      putString(ofs, fModel.fRegions[i].type);
+      putAttributes(ofs, fModel.fRegions[i].attributes);
+   }
+
+   putInt(ofs, fModel.fVolumes.size());
+   for (unsigned int i = 0; i < fModel.fVolumes.size(); i++)
+   {
+      const GeometryModel::Volume& vol = fModel.fVolumes[i];
+      putString(ofs, vol.name);
+      putString(ofs, vol.tag);
+      putString(ofs, vol.envelope);
+      putInt(ofs, vol.material);
+      putAttributes(ofs, vol.attributes);
+   }
+
+   putArray(ofs, fModel.fParent);
+   putArray(ofs, fModel.fVolume);
+   putArray(ofs, fModel.fRegion);
+   for (int i = 0; i < 3; i++)
+   {
+      putArray(ofs, fModel.fOrigin[i]);
+   }
+   for (int i = 0; i < 9; i++)
+   {
+      putArray(ofs, fModel.fRmatrix[i]);
+   }
+   putArray(ofs, fModel.fIdentStart);
+   putArray(ofs, fModel.fIdentField);
+   putArray(ofs, fModel.fIdentValue);
+
+   ofs.write(HDDS_CACHE_MAGIC, sizeof(HDDS_CACHE_MAGIC));
+   ofs.close();
+   if (ofs.fail() || rename(tmpPath.c_str(), path.c_str()) != 0)
+   {
+      remove(tmpPath.c_str());
+      return false;
+   }
+   return true;
+}
+
+void GeometryCache::compile(DOMElement* topel)
+{
+   fChecksum = last_md5_checksum;
+   fSources = last_md5_filenames;
+   fModel.build(topel);
+}
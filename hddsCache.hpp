@@ -0,0 +1,52 @@
+/*  HDDS Geometry Cache
+ *
+ *  Original version - October 17, 2026.
+ *
+ */
+
+#ifndef SAW_HDDSCACHE_DEF
+#define SAW_HDDSCACHE_DEF true
+
+#include <vector>
+#include <string>
+
+#include <xercesc/dom/DOM.hpp>
+
+using namespace xercesc;
+
+#include "XString.hpp"
+#include "hddsModel.hpp"
+
+class GeometryCache
+{
+ /* The GeometryCache class stores a GeometryModel in a binary file next
+  * to the top-level xml document, keyed by the MD5 checksum that
+  * MyEntityResolver computes over all of the xml files that went into
+  * the parse.  Before a cache file is used the checksum is recomputed
+  * from the list of files stored in it, so a modification to any of the
+  * sources makes the cache stale and forces the caller back to a full
+  * parse.  The cache serves the tools that only need the geometry
+  * (hddsBrowser, findall, hdds-md5).  The code writers behind
+  * hdds-geant, hdds-root, hdds-root_h and hdds-all generate their output
+  * from the DOM, so those translators parse every time and do not use
+  * the cache.
+  */
+ public:
+   GeometryCache();
+
+   static std::string cachePath(const XString& xmlFile);
+   static bool isCurrent(const XString& xmlFile); // valid cache on disk?
+
+   bool load(const XString& xmlFile);	// read cache, false if stale
+   bool save(const XString& xmlFile) const;	// write cache, false on error
+   void compile(DOMElement* topel);	// build model from parsed document
+
+   std::string fChecksum;		// MD5 checksum of the sources
+   std::vector<std::string> fSources;	// xml files behind the checksum
+   GeometryModel fModel;		// the cached geometry
+
+ private:
+   void clear();
+};
+
+#endif
@@ -113,6 +113,7 @@ using namespace xercesc;
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include <iostream>
@@ -120,12 +121,13 @@ using namespace xercesc;
 #include <sstream>
 #include <string>
 #include <iomanip>
+#include <locale>
 #include <vector>
 #include <list>
 
 #define APP_NAME "hddsCommon"
 
-#define X(str) XString(str).unicode_str()
+#define X(str) XName(str)
 #define S(str) str.c_str()
 
 #define NOT_USED(x) ((void)(x))
@@ -136,14 +138,9 @@ using namespace xercesc;
  *	volumes in the simulation geometry.
  */
 
-int Refsys::fVolumes = 0;
-int Refsys::fRegions = 0;
-int Refsys::fRotations = 0;
-std::map<std::string,Refsys::VolIdent> Refsys::fIdentifiers;
-std::vector<std::map<std::string,std::vector<int> > > Refsys::fIdentifierTable;
-
 Refsys::Refsys()			// empty constructor
  : fMother(0),
+   fDivision(0),
    fRegion(0),
    fPhiOffset(0),
    fRegionID(0),
@@ -155,18 +152,22 @@ Refsys::Refsys()			// empty constructor
    fMRmatrix[0][0] = fMRmatrix[1][1] = fMRmatrix[2][2] = 1;
    fMRmatrix[0][1] = fMRmatrix[1][0] = fMRmatrix[1][2] =
    fMRmatrix[0][2] = fMRmatrix[2][0] = fMRmatrix[2][1] = 0;
+   fPartition.divName = 0;
+   fPartition.axis = "";
    reset();
 }
 
 Refsys::Refsys(const Refsys& src)	// copy constructor
  : fMother(src.fMother),
+   fDivision(src.fDivision),
    fRegion(src.fRegion),
    fPhiOffset(src.fPhiOffset),
    fRegionID(src.fRegionID),
    fGeometryLayer(src.fGeometryLayer),
    fRelativeLayer(src.fRelativeLayer),
    fIdentifier(src.fIdentifier),
-   fPartition(src.fPartition)
+   fPartition(src.fPartition),
+   fPar(src.fPar)
 {
    for (int i=0; i<3; i++)
    {
@@ -175,11 +176,6 @@ Refsys::Refsys(const Refsys& src)	// copy constructor
       fMRmatrix[i][1] = src.fMRmatrix[i][1];
       fMRmatrix[i][2] = src.fMRmatrix[i][2];
    }
-   std::map<std::string,double>::const_iterator iter;
-   for (iter = src.fPar.begin(); iter != src.fPar.end(); ++iter)
-   {
-      fPar[iter->first] = iter->second;
-   }
    reset(src);
 }
 
@@ -187,6 +183,7 @@ Refsys& Refsys::operator=(Refsys& src)	// copy operator (deep sematics)
 {
    fIdentifier = src.fIdentifier;
    fMother = src.fMother;
+   fDivision = src.fDivision;
    fRegion = src.fRegion;
    fRegionID = src.fRegionID;
    fGeometryLayer = src.fGeometryLayer;
@@ -200,10 +197,17 @@ Refsys& Refsys::operator=(Refsys& src)	// copy operator (deep sematics)
       fMRmatrix[i][1] = src.fMRmatrix[i][1];
       fMRmatrix[i][2] = src.fMRmatrix[i][2];
    }
-   std::map<std::string,double>::iterator iter;
-   for (iter = src.fPar.begin(); iter != src.fPar.end(); ++iter)
+   if (fPar.empty())
+   {
+      fPar = src.fPar;
+   }
+   else
    {
-      fPar[iter->first] = iter->second;
+      std::map<std::string,double>::const_iterator iter;
+      for (iter = src.fPar.begin(); iter != src.fPar.end(); ++iter)
+      {
+         fPar[iter->first] = iter->second;
+      }
    }
    reset(src);
    return *this;
@@ -257,54 +261,70 @@ Refsys& Refsys::shift(const Refsys& ref)      // copy origin from ref
    return *this;
 }
 
+static void shiftOrigin(double origin[3], const double Rmatrix[3][3],
+                        const double vector[3])
+{
+   for (int i = 0; i < 3; i++)
+   {
+      origin[i] += Rmatrix[i][0] * vector[0] +
+                   Rmatrix[i][1] * vector[1] +
+                   Rmatrix[i][2] * vector[2];
+   }
+}
+
+static bool rotateMatrix(double Rmatrix[3][3], const double omega[3])
+{
+   // R --> R Rz Ry Rx, see the description of the Refsys class
+   if ( (omega[0] == 0) && (omega[1] == 0) && (omega[2] == 0) )
+   {
+      return false;
+   }
+
+   double cosx = cos(omega[0]);
+   double sinx = sin(omega[0]);
+   double cosy = cos(omega[1]);
+   double siny = sin(omega[1]);
+   double cosz = cos(omega[2]);
+   double sinz = sin(omega[2]);
+
+   for (int i = 0; i < 3; i++)
+   {
+      double x[3];
+      double xx[3];
+
+      x[0] = Rmatrix[i][0] * cosz + Rmatrix[i][1] * sinz;
+      x[1] = Rmatrix[i][1] * cosz - Rmatrix[i][0] * sinz;
+      x[2] = Rmatrix[i][2];
+      xx[0] = x[0] * cosy - x[2] * siny;
+      xx[1] = x[1];
+      xx[2] = x[2] * cosy + x[0] * siny;
+      Rmatrix[i][0] = xx[0];
+      Rmatrix[i][1] = xx[1] * cosx + xx[2] * sinx;
+      Rmatrix[i][2] = xx[2] * cosx - xx[1] * sinx;
+   }
+   return true;
+}
+
 Refsys& Refsys::shift(const Refsys& ref,
                       const double vector[3]) // translate origin in ref frame
 {
-   Refsys myRef(ref);
-   myRef.shift(vector);
-   return shift(myRef);
+   for (int i = 0; i < 3; i++)
+   {
+      fOrigin[i] = ref.fOrigin[i];
+      fMOrigin[i] = ref.fMOrigin[i];
+   }
+   shiftOrigin(fOrigin, ref.fRmatrix, vector);
+   shiftOrigin(fMOrigin, ref.fMRmatrix, vector);
+   return *this;
 }
 
 Refsys& Refsys::rotate(const double omega[3]) // rotate by vector omega (rad)
 {
-   if ( (omega[0] != 0) || (omega[1] != 0) || (omega[2] != 0) )
+   if (rotateMatrix(fRmatrix, omega))
    {
-      double cosx = cos(omega[0]);
-      double sinx = sin(omega[0]);
-      double cosy = cos(omega[1]);
-      double siny = sin(omega[1]);
-      double cosz = cos(omega[2]);
-      double sinz = sin(omega[2]);
-
-      for (int i = 0; i < 3; i++)
-      {
-         double x[3];
-         double xx[3];
-
-         x[0] = fRmatrix[i][0] * cosz + fRmatrix[i][1] * sinz;
-         x[1] = fRmatrix[i][1] * cosz - fRmatrix[i][0] * sinz;
-         x[2] = fRmatrix[i][2];
-         xx[0] = x[0] * cosy - x[2] * siny;
-         xx[1] = x[1];
-         xx[2] = x[2] * cosy + x[0] * siny;
-         fRmatrix[i][0] = xx[0];
-         fRmatrix[i][1] = xx[1] * cosx + xx[2] * sinx;
-         fRmatrix[i][2] = xx[2] * cosx - xx[1] * sinx;
-
-         x[0] = fMRmatrix[i][0] * cosz + fMRmatrix[i][1] * sinz;
-         x[1] = fMRmatrix[i][1] * cosz - fMRmatrix[i][0] * sinz;
-         x[2] = fMRmatrix[i][2];
-         xx[0] = x[0] * cosy - x[2] * siny;
-         xx[1] = x[1];
-         xx[2] = x[2] * cosy + x[0] * siny;
-         fMRmatrix[i][0] = xx[0];
-         fMRmatrix[i][1] = xx[1] * cosx + xx[2] * sinx;
-         fMRmatrix[i][2] = xx[2] * cosx - xx[1] * sinx;
-      }
-
+      rotateMatrix(fMRmatrix, omega);
       fRotation = -1;
    }
-
    return *this;
 }
 
@@ -326,57 +346,230 @@ Refsys& Refsys::rotate(const Refsys& ref)      // copy Rmatrix from ref
 Refsys& Refsys::rotate(const Refsys& ref,
                        const double omega[3])  // rotate by omega in ref frame
 {
-   Refsys myRef(ref);
-   myRef.rotate(omega);
-   return rotate(myRef);
+   rotate(ref);
+   return rotate(omega);
 }
 
-std::vector<double>& Refsys::getRotation() const
+XString Refsys::getMotherName() const
 {
-   std::vector<double> *angles = new std::vector<double>(3);
-   if (fRmatrix[2][1] == 0 && fRmatrix[2][2] == 0) {
-      if (fRmatrix[2][0] < 0) {
-         (*angles)[0] = atan2(fRmatrix[0][1],fRmatrix[1][1]);
-         (*angles)[1] = M_PI/2.;
-         (*angles)[2] = 0;
+   if (fDivision != 0)
+   {
+      return XString(*fDivision);
+   }
+   return XString(fMother->getAttribute(X("name")));
+}
+
+static Refsys::EulerAngles eulerAngles(const double Rmatrix[3][3])
+{
+   Refsys::EulerAngles angles;
+   if (Rmatrix[2][1] == 0 && Rmatrix[2][2] == 0) {
+      if (Rmatrix[2][0] < 0) {
+         angles[0] = atan2(Rmatrix[0][1],Rmatrix[1][1]);
+         angles[1] = M_PI/2.;
+         angles[2] = 0;
       }
       else {
-         (*angles)[0] = atan2(-fRmatrix[0][1],fRmatrix[1][1]);
-         (*angles)[1] = -M_PI/2.;
-         (*angles)[2] = 0;
+         angles[0] = atan2(-Rmatrix[0][1],Rmatrix[1][1]);
+         angles[1] = -M_PI/2.;
+         angles[2] = 0;
       }
    }
    else {
-      (*angles)[0] = atan2(fRmatrix[2][1],fRmatrix[2][2]);
-      (*angles)[1] = atan2(-fRmatrix[2][0],
-                            fRmatrix[2][2]/(cos((*angles)[0])+1e-100));
-      (*angles)[2] = atan2(fRmatrix[1][0],fRmatrix[0][0]);
+      angles[0] = atan2(Rmatrix[2][1],Rmatrix[2][2]);
+      angles[1] = atan2(-Rmatrix[2][0],
+                         Rmatrix[2][2]/(cos(angles[0])+1e-100));
+      angles[2] = atan2(Rmatrix[1][0],Rmatrix[0][0]);
    }
-   return *angles;
+   return angles;
 }
 
-std::vector<double>& Refsys::getMRotation() const
+Refsys::EulerAngles Refsys::getRotation() const
 {
-   std::vector<double> *angles = new std::vector<double>(3);
-   if (fMRmatrix[2][1] == 0 && fMRmatrix[2][2] == 0) {
-      if (fMRmatrix[2][0] < 0) {
-         (*angles)[0] = atan2(fMRmatrix[0][1],fMRmatrix[1][1]);
-         (*angles)[1] = M_PI/2.;
-         (*angles)[2] = 0;
+   return eulerAngles(fRmatrix);
+}
+
+Refsys::EulerAngles Refsys::getMRotation() const
+{
+   return eulerAngles(fMRmatrix);
+}
+
+void Refsys::placeSeries(const Refsys& ref,
+                         const std::vector<double>& vectors,
+                         const std::vector<double>& omegas,
+                         std::vector<Placement>& series)
+{
+   int ncopy = vectors.size() / 3;
+   series.resize(ncopy);
+   for (int ic = 0; ic < ncopy; ic++)
+   {
+      Placement& copy = series[ic];
+      for (int i = 0; i < 3; i++)
+      {
+         copy.origin[i] = ref.fOrigin[i];
+         copy.morigin[i] = ref.fMOrigin[i];
       }
-      else {
-         (*angles)[0] = atan2(-fMRmatrix[0][1],fMRmatrix[1][1]);
-         (*angles)[1] = -M_PI/2.;
-         (*angles)[2] = 0;
+      shiftOrigin(copy.origin, ref.fRmatrix, &vectors[3*ic]);
+      shiftOrigin(copy.morigin, ref.fMRmatrix, &vectors[3*ic]);
+   }
+   if (omegas.size() < vectors.size())
+   {
+      return;
+   }
+   for (int ic = 0; ic < ncopy; ic++)
+   {
+      Placement& copy = series[ic];
+      for (int i = 0; i < 3; i++)
+      {
+         for (int j = 0; j < 3; j++)
+         {
+            copy.rmatrix[i][j] = ref.fRmatrix[i][j];
+            copy.mrmatrix[i][j] = ref.fMRmatrix[i][j];
+         }
+      }
+      copy.rotation = ref.fRotation;
+      if (rotateMatrix(copy.rmatrix, &omegas[3*ic]))
+      {
+         rotateMatrix(copy.mrmatrix, &omegas[3*ic]);
+         copy.rotation = -1;
       }
    }
-   else {
-      (*angles)[0] = atan2(fMRmatrix[2][1],fMRmatrix[2][2]);
-      (*angles)[1] = atan2(-fMRmatrix[2][0],
-                            fMRmatrix[2][2]/(cos((*angles)[0])+1e-100));
-      (*angles)[2] = atan2(fMRmatrix[1][0],fMRmatrix[0][0]);
+}
+
+bool Refsys::placeCopies(const Refsys& ref, DOMElement* mposEl,
+                         const double omega[3], std::vector<Placement>& series)
+{
+   HddsTag comd = hddsTag(mposEl);
+   const Units& unit = Units::forElement(mposEl);
+   XString ncopyS(mposEl->getAttribute(X("ncopy")));
+   int ncopy = atoi(S(ncopyS));
+   double s = AttributeDecoder::value(mposEl, "S") /unit.cm;
+   std::vector<double> shifts;
+   std::vector<double> omegas;
+   double origin[3];
+
+   if (comd == kMposPhiTag)
+   {
+      double phi0 = AttributeDecoder::value(mposEl, "Phi0") /unit.rad;
+      double dphi = 2 * M_PI / ((ncopy > 0)? ncopy : 1);
+      if (AttributeDecoder::values(mposEl, "dPhi").size() != 0)
+      {
+         dphi = AttributeDecoder::value(mposEl, "dPhi") /unit.rad;
+      }
+      double r=0, z=0;
+      AttributeDecoder::get(mposEl, "R_Z", r, z);
+      r /= unit.cm;
+      z /= unit.cm;
+      XString implrotS(mposEl->getAttribute(X("impliedRot")));
+      double angle[3] = {omega[0], omega[1], omega[2]};
+      for (int inst = 0; inst < ncopy; inst++)
+      {
+         double phi = phi0 + inst * dphi;
+         shifts.push_back(r * cos(phi) - s * sin(phi));
+         shifts.push_back(r * sin(phi) + s * cos(phi));
+         shifts.push_back(z);
+         if (implrotS == "true")
+         {
+            angle[2] += ((inst == 0) ? phi0 : dphi);
+            omegas.insert(omegas.end(), angle, angle + 3);
+         }
+      }
+   }
+   else if (comd == kMposRTag)
+   {
+      double r0 = AttributeDecoder::value(mposEl, "R0") /unit.cm;
+      double dr = AttributeDecoder::value(mposEl, "dR") /unit.cm;
+      double phi=0, z=0;
+      AttributeDecoder::get(mposEl, "Z_Phi", z, phi);
+      phi /= unit.rad;
+      z /= unit.cm;
+      for (int inst = 0; inst < ncopy; inst++)
+      {
+         double r = r0 + inst * dr;
+         shifts.push_back(r * cos(phi) - s * sin(phi));
+         shifts.push_back(r * sin(phi) + s * cos(phi));
+         shifts.push_back(z);
+      }
+   }
+   else if (comd == kMposXTag)
+   {
+      double x0 = AttributeDecoder::value(mposEl, "X0") /unit.cm;
+      double dx = AttributeDecoder::value(mposEl, "dX") /unit.cm;
+      double y=0, z=0;
+      AttributeDecoder::get(mposEl, "Y_Z", y, z);
+      y /= unit.cm;
+      z /= unit.cm;
+      for (int inst = 0; inst < ncopy; inst++)
+      {
+         origin[0] = x0 + inst * dx;
+         origin[1] = y + s;
+         origin[2] = z;
+         shifts.insert(shifts.end(), origin, origin + 3);
+      }
+   }
+   else if (comd == kMposYTag)
+   {
+      double y0 = AttributeDecoder::value(mposEl, "Y0") /unit.cm;
+      double dy = AttributeDecoder::value(mposEl, "dY") /unit.cm;
+      double x=0, z=0;
+      AttributeDecoder::get(mposEl, "Z_X", z, x);
+      x /= unit.cm;
+      z /= unit.cm;
+      for (int inst = 0; inst < ncopy; inst++)
+      {
+         origin[0] = x;
+         origin[1] = y0 + inst * dy;
+         origin[2] = z;
+         shifts.insert(shifts.end(), origin, origin + 3);
+      }
    }
-   return *angles;
+   else if (comd == kMposZTag)
+   {
+      double z0 = AttributeDecoder::value(mposEl, "Z0") /unit.cm;
+      double dz = AttributeDecoder::value(mposEl, "dZ") /unit.cm;
+      double x=0, y=0;
+      if (AttributeDecoder::get(mposEl, "X_Y", x, y) == 0)
+      {
+         double r=0, phi=0;
+         AttributeDecoder::get(mposEl, "R_Phi", r, phi);
+         phi /= unit.rad;
+         x = r * cos(phi);
+         y = r * sin(phi);
+      }
+      x /= unit.cm;
+      y /= unit.cm;
+      double phi = atan2(y,x);
+      origin[0] = x - s * sin(phi);
+      origin[1] = y + s * cos(phi);
+      for (int inst = 0; inst < ncopy; inst++)
+      {
+         origin[2] = z0 + inst * dz;
+         shifts.insert(shifts.end(), origin, origin + 3);
+      }
+   }
+   placeSeries(ref, shifts, omegas, series);
+   return (omegas.size() > 0);
+}
+
+Refsys& Refsys::place(const Placement& copy, bool rotated)
+{
+   for (int i = 0; i < 3; i++)
+   {
+      fOrigin[i] = copy.origin[i];
+      fMOrigin[i] = copy.morigin[i];
+   }
+   if (rotated)
+   {
+      for (int i = 0; i < 3; i++)
+      {
+         for (int j = 0; j < 3; j++)
+         {
+            fRmatrix[i][j] = copy.rmatrix[i][j];
+            fMRmatrix[i][j] = copy.mrmatrix[i][j];
+         }
+      }
+      fRotation = copy.rotation;
+   }
+   return *this;
 }
 
 void Refsys::clearIdentifiers()
@@ -386,8 +579,13 @@ void Refsys::clearIdentifiers()
 
 void Refsys::incrementIdentifiers()
 {
+   if (fIdentifier.empty())
+   {
+      return;
+   }
+   std::map<std::string,Refsys::VolIdent>& ids = fIdentifier.modify();
    std::map<std::string,Refsys::VolIdent>::iterator iter;
-   for (iter = fIdentifier.begin(); iter != fIdentifier.end(); ++iter)
+   for (iter = ids.begin(); iter != ids.end(); ++iter)
    {
       iter->second.value += iter->second.step;
    }
@@ -399,28 +597,114 @@ void Refsys::addIdentifier(XString ident, int value, int step)
    id.value = value;
    id.step = step;
    fIdentifier[ident] = id;
-   fIdentifiers[ident] = id;
 }
 
-int Refsys::nextRotationID()
+const double RotationRegistry::fSnapTolerance = 1e-10;
+const double RotationRegistry::fMatchTolerance = 1e-10;
+const double RotationRegistry::fKeyTolerance = 1e4 * fMatchTolerance;
+						// weights add up to 9841
+
+void RotationRegistry::snap(double Rmatrix[3][3])
 {
-   return ++fRotations;
+   for (int i = 0; i < 3; i++)
+   {
+      for (int j = 0; j < 3; j++)
+      {
+         double& r = Rmatrix[i][j];
+         if (fabs(r) < fSnapTolerance)
+         {
+            r = 0;
+         }
+         else if (fabs(r - 1) < fSnapTolerance)
+         {
+            r = 1;
+         }
+         else if (fabs(r + 1) < fSnapTolerance)
+         {
+            r = -1;
+         }
+      }
+   }
 }
 
-int Refsys::nextVolumeID()
+bool RotationRegistry::isIdentity(const double Rmatrix[3][3])
 {
-   unsigned int ivolu = ++fVolumes;
-   while (fIdentifierTable.size() <= ivolu)
+   for (int i = 0; i < 3; i++)
    {
-      std::map<std::string,std::vector<int> > unmarked;
-      fIdentifierTable.push_back(unmarked);
+      for (int j = 0; j < 3; j++)
+      {
+         if (Rmatrix[i][j] != ((i == j)? 1 : 0))
+         {
+            return false;
+         }
+      }
    }
-   return ivolu;
+   return true;
 }
 
-int Refsys::nextRegionID()
+double RotationRegistry::key(const double Rmatrix[3][3])
 {
-   return ++fRegions;
+   double k = 0;
+   double weight = 1;
+   for (int i = 0; i < 3; i++)
+   {
+      for (int j = 0; j < 3; j++)
+      {
+         k += weight * Rmatrix[i][j];
+         weight *= 3;
+      }
+   }
+   return k;
+}
+
+int RotationRegistry::find(const double Rmatrix[3][3]) const
+{
+   typedef std::multimap<double,Entry>::const_iterator Iter;
+   double k = key(Rmatrix);
+   Iter last = fEntries.upper_bound(k + fKeyTolerance);
+   for (Iter iter = fEntries.lower_bound(k - fKeyTolerance);
+        iter != last; ++iter)
+   {
+      const Entry& entry = iter->second;
+      bool same = true;
+      for (int i = 0; i < 3 && same; i++)
+      {
+         for (int j = 0; j < 3 && same; j++)
+         {
+            same = (fabs(entry.rmatrix[i][j] - Rmatrix[i][j])
+                    <= fMatchTolerance);
+         }
+      }
+      if (same)
+      {
+         return entry.irot;
+      }
+   }
+   return 0;
+}
+
+void RotationRegistry::insert(const double Rmatrix[3][3], int irot)
+{
+   Entry entry;
+   for (int i = 0; i < 3; i++)
+   {
+      for (int j = 0; j < 3; j++)
+      {
+         entry.rmatrix[i][j] = Rmatrix[i][j];
+      }
+   }
+   entry.irot = irot;
+   fEntries.insert(std::make_pair(key(Rmatrix), entry));
+}
+
+int RotationRegistry::size() const
+{
+   return fEntries.size();
+}
+
+void RotationRegistry::clear()
+{
+   fEntries.clear();
 }
 
 /* Substance class:
@@ -443,28 +727,6 @@ Substance::Substance()
    fMIdEdx(0)
 {}
 
-Substance::Substance(const Substance& src)
- : fUniqueID(src.fUniqueID),
-   fMaterialEl(src.fMaterialEl),
-   fAtomicWeight(src.fAtomicWeight),
-   fAtomicNumber(src.fAtomicNumber),
-   fDensity(src.fDensity),
-   fRadLen(src.fRadLen),
-   fAbsLen(src.fAbsLen),
-   fColLen(src.fColLen),
-   fMIdEdx(src.fMIdEdx)
-{
-   std::list<Brew>::const_iterator iter;
-   for (iter = src.fBrewList.begin();
-        iter != src.fBrewList.end();
-        ++iter)
-   {
-      Brew formula = *iter;
-      formula.sub = new Substance(*iter->sub);
-      fBrewList.push_back(formula);
-   }
-}
-
 Substance::Substance(DOMElement* elem)
  : fUniqueID(0),
    fBrewList(0),
@@ -477,10 +739,8 @@ Substance::Substance(DOMElement* elem)
    fColLen(0),
    fMIdEdx(0)
 {
-   XString aS(fMaterialEl->getAttribute(X("a")));
-   fAtomicWeight = atof(S(aS));
-   XString zS(fMaterialEl->getAttribute(X("z")));
-   fAtomicNumber = atof(S(zS));
+   fAtomicWeight = AttributeDecoder::value(fMaterialEl, "a");
+   fAtomicNumber = AttributeDecoder::value(fMaterialEl, "z");
 
    double wfactSum = 0;
 
@@ -494,8 +754,7 @@ Substance::Substance(DOMElement* elem)
          XString tagS(contEl->getTagName());
          if (tagS == "real")
          {
-            Units unit;
-            unit.getConversions(contEl);
+            const Units& unit = Units::forElement(contEl);
             XString nameS(contEl->getAttribute(X("name")));
             XString valueS(contEl->getAttribute(X("value")));
             if (nameS == "density")
@@ -523,10 +782,10 @@ Substance::Substance(DOMElement* elem)
          {
             XString matS(contEl->getAttribute(X("material")));
             DOMDocument* document = fMaterialEl->getOwnerDocument();
-            DOMElement* targEl = document->getElementById(X(matS));
+            DOMElement* targEl = loadElementById(document, matS);
             XString typeS(targEl->getTagName());
             Substance::Brew formula;
-            formula.sub = new Substance(targEl);
+            formula.sub = &MaterialRegistry::get(targEl);
             formula.natoms = 0;
             formula.wfact = 0;
             DOMNode* mix;
@@ -554,8 +813,7 @@ Substance::Substance(DOMElement* elem)
                   }
                   else if (mixS == "fractionmass")
                   {
-                     XString fS(mixEl->getAttribute(X("fraction")));
-                     formula.wfact = atof(S(fS));
+                     formula.wfact = AttributeDecoder::value(mixEl, "fraction");
                   }
                }
             }
@@ -644,87 +902,172 @@ Substance::Substance(DOMElement* elem)
    }
 }
 
-Substance::~Substance()
-{
-   std::list<Brew>::iterator iter;
-   for (iter = fBrewList.begin(); iter != fBrewList.end(); ++iter)
-   {
-      delete iter->sub;
-   }
-}
-
-Substance& Substance::operator=(const Substance& src)
-{
-   fMaterialEl = src.fMaterialEl;
-   fAtomicWeight = src.fAtomicWeight;
-   fAtomicNumber = src.fAtomicNumber;
-   fDensity = src.fDensity;
-   fRadLen = src.fRadLen;
-   fAbsLen = src.fAbsLen;
-   fColLen = src.fColLen;
-   fMIdEdx = src.fMIdEdx;
-   fUniqueID = src.fUniqueID;
-   fBrewList = src.fBrewList;
-   std::list<Brew>::iterator iter;
-   for (iter = fBrewList.begin();
-        iter != fBrewList.end();
-        ++iter)
-   {
-      iter->sub = new Substance(*iter->sub);
-   }
-   return *this;
-}
-
-double Substance::getAtomicWeight()
+double Substance::getAtomicWeight() const
 {
    return fAtomicWeight;
 }
 
-double Substance::getAtomicNumber()
+double Substance::getAtomicNumber() const
 {
    return fAtomicNumber;
 }
 
-double Substance::getDensity()
+double Substance::getDensity() const
 {
    return fDensity;
 }
 
-double Substance::getRadLength()
+double Substance::getRadLength() const
 {
    return fRadLen;
 }
 
-double Substance::getAbsLength()
+double Substance::getAbsLength() const
 {
    return fAbsLen;
 }
 
-double Substance::getColLength()
+double Substance::getColLength() const
 {
    return fColLen;
 }
 
-double Substance::getMIdEdx()
+double Substance::getMIdEdx() const
 {
    return fMIdEdx;
 }
 
-XString Substance::getName()
+XString Substance::getName() const
 {
    return XString(fMaterialEl->getAttribute(X("name")));
 }
 
-XString Substance::getSymbol()
+XString Substance::getSymbol() const
 {
    return XString(fMaterialEl->getAttribute(X("symbol")));
 }
 
-DOMElement* Substance::getDOMElement()
+DOMElement* Substance::getDOMElement() const
 {
    return fMaterialEl;
 }
 
+std::map<const DOMElement*,Substance*> MaterialRegistry::fSubstances;
+
+Substance& MaterialRegistry::get(DOMElement* el)
+{
+   std::map<const DOMElement*,Substance*>::iterator iter;
+   iter = fSubstances.find(el);
+   if (iter != fSubstances.end())
+   {
+      return *iter->second;
+   }
+   Substance* subst = new Substance(el);
+   fSubstances[el] = subst;
+   return *subst;
+}
+
+void MaterialRegistry::clear()
+{
+   std::map<const DOMElement*,Substance*>::iterator iter;
+   for (iter = fSubstances.begin(); iter != fSubstances.end(); ++iter)
+   {
+      delete iter->second;
+   }
+   fSubstances.clear();
+}
+
+ElementTable::Entry::Entry()
+ : volu(0),
+   copy(-1),
+   mate(0),
+   region(0),
+   nprofile(0)
+{
+   profile[0] = profile[1] = 0;
+}
+
+ElementTable::Entry& ElementTable::operator[](const DOMElement* el)
+{
+   std::map<const DOMElement*,int>::iterator iter = fOrdinal.find(el);
+   if (iter != fOrdinal.end())
+   {
+      return fEntries[iter->second];
+   }
+   fOrdinal[el] = fEntries.size();
+   fEntries.push_back(Entry());
+   return fEntries.back();
+}
+
+const ElementTable::Entry* ElementTable::find(const DOMElement* el) const
+{
+   int ord = ordinal(el);
+   return (ord < 0)? 0 : &fEntries[ord];
+}
+
+int ElementTable::ordinal(const DOMElement* el) const
+{
+   std::map<const DOMElement*,int>::const_iterator iter = fOrdinal.find(el);
+   return (iter == fOrdinal.end())? -1 : iter->second;
+}
+
+int ElementTable::size() const
+{
+   return fEntries.size();
+}
+
+void ElementTable::clear()
+{
+   fOrdinal.clear();
+   fEntries.clear();
+}
+
+/* TranslationContext class:
+ *	Holds the index counters and tables of one translation.
+ */
+
+TranslationContext::TranslationContext()
+{
+   clear();
+}
+
+void TranslationContext::clear()
+{
+   fRotations = 0;
+   fRegions = 0;
+   fVolumes = 0;
+   fMaterialCount = 0;
+   fMediumCount = 0;
+   fPhiDivisions = fRDivisions = 0xd00;
+   fXDivisions = fYDivisions = fZDivisions = 0xd00;
+   fIdentifiers.clear();
+   fIdentifierTable.clear();
+   fRotationTable.clear();
+   fTable.clear();
+   fDivisionNames.clear();
+}
+
+int TranslationContext::nextRotationID()
+{
+   return ++fRotations;
+}
+
+int TranslationContext::nextRegionID()
+{
+   return ++fRegions;
+}
+
+int TranslationContext::nextVolumeID()
+{
+   unsigned int ivolu = ++fVolumes;
+   while (fIdentifierTable.size() <= ivolu)
+   {
+      std::map<std::string,std::vector<int> > unmarked;
+      fIdentifierTable.push_back(unmarked);
+   }
+   return ivolu;
+}
+
 
 /* Units class:
  *	Provides conversion constants for convenient extraction of
@@ -816,199 +1159,417 @@ void Units::set_1G(double bfu)
    kG=G*1e3; Tesla=kG*10;
 }
 
-void Units::getConversions(DOMElement* el)
+std::map<std::string,Units::Scale> Units::fScales;
+std::map<const DOMElement*,Units> Units::fElementUnits;
+
+const Units::Scale& Units::resolve(DOMElement* el)
 {
    XString unitlS(el->getAttribute(X("unit_length")));
-   if (unitlS.size() == 0)
-   {
-      ;
-   }
-   else if (unitlS == "mm")
-   {
-      set_1cm(10);
-   }
-   else if (unitlS == "cm")
-   {
-      set_1cm(1);
-   }
-   else if (unitlS == "m")
-   {
-      set_1cm(0.01);
-   }
-   else if (unitlS == "km")
-   {
-      set_1cm(1e-5);
-   }
-   else if (unitlS == "um")
-   {
-      set_1cm(1e6);
-   }
-   else if (unitlS == "nm")
-   {
-      set_1cm(1e9);
-   }
-   else if (unitlS == "in")
-   {
-      set_1cm(1/2.54);
-   }
-   else if (unitlS == "ft")
-   {
-      set_1cm(1/(12*2.54));
-   }
-   else if (unitlS == "mil")
-   {
-      set_1cm(1000/2.54);
-   }
-   else
-   {
-      XString tagS(el->getTagName());
-      std::cerr
-           << APP_NAME << " error: unknown length unit " << S(unitlS)
-           << " on tag " << S(tagS) << std::endl;
-      exit(1);
+   XString unitaS(el->getAttribute(X("unit_angle")));
+   XString unitS(el->getAttribute(X("unit")));
+   std::string key = unitlS + "|" + unitaS + "|" + unitS;
+   std::map<std::string,Scale>::iterator iter = fScales.find(key);
+   if (iter != fScales.end())
+   {
+      return iter->second;
+   }
+
+   struct Entry
+   {
+      const char* name;
+      Scale scale;
+   };
+   static const Entry lengthUnits[] = {
+      {"mm",         {10,           0, false, 0, 0, 0, 0, 0}},
+      {"cm",         {1,            0, false, 0, 0, 0, 0, 0}},
+      {"m",          {0.01,         0, false, 0, 0, 0, 0, 0}},
+      {"km",         {1e-5,         0, false, 0, 0, 0, 0, 0}},
+      {"um",         {1e6,          0, false, 0, 0, 0, 0, 0}},
+      {"nm",         {1e9,          0, false, 0, 0, 0, 0, 0}},
+      {"in",         {1/2.54,       0, false, 0, 0, 0, 0, 0}},
+      {"ft",         {1/(12*2.54),  0, false, 0, 0, 0, 0, 0}},
+      {"mil",        {1000/2.54,    0, false, 0, 0, 0, 0, 0}}
+   };
+   static const Entry angleUnits[] = {
+      {"deg",        {0, 1,   true,  0, 0, 0, 0, 0}},
+      {"rad",        {0, 1,   false, 0, 0, 0, 0, 0}},
+      {"mrad",       {0, 1e3, false, 0, 0, 0, 0, 0}}
+   };
+   static const Entry otherUnits[] = {
+      {"mm",         {10,   0, false, 0,    0, 0, 0, 0}},
+      {"cm",         {1,    0, false, 0,    0, 0, 0, 0}},
+      {"m",          {0.01, 0, false, 0,    0, 0, 0, 0}},
+      {"eV",         {0,    0, false, 1e6,  0, 0, 0, 0}},
+      {"KeV",        {0,    0, false, 1e3,  0, 0, 0, 0}},
+      {"MeV",        {0,    0, false, 1,    0, 0, 0, 0}},
+      {"GeV",        {0,    0, false, 1e-3, 0, 0, 0, 0}},
+      {"g/cm^2",     {0,    0, false, 0,    1, 1, 0, 0}},
+      {"g/cm^3",     {0,    0, false, 0,    1, 0, 1, 0}},
+      {"MeV/g/cm^2", {0,    0, false, 1,    1, 1, 0, 0}},
+      {"Tesla",      {0,    0, false, 0,    0, 0, 0, 1e-4}},
+      {"T",          {0,    0, false, 0,    0, 0, 0, 1e-4}},
+      {"kG",         {0,    0, false, 0,    0, 0, 0, 1e-3}},
+      {"kGs",        {0,    0, false, 0,    0, 0, 0, 1e-3}},
+      {"G",          {0,    0, false, 0,    0, 0, 0, 1}},
+      {"Gs",         {0,    0, false, 0,    0, 0, 0, 1}},
+      {"percent",    {0,    0, false, 0,    0, 0, 0, 0}},
+      {"none",       {0,    0, false, 0,    0, 0, 0, 0}}
+   };
+   static const int nlengthUnits = sizeof(lengthUnits)/sizeof(Entry);
+   static const int nangleUnits = sizeof(angleUnits)/sizeof(Entry);
+   static const int notherUnits = sizeof(otherUnits)/sizeof(Entry);
+
+   Scale scale = {0, 0, false, 0, 0, 0, 0, 0};
+   int ilength = -1;
+   if (unitlS.size() != 0)
+   {
+      for (ilength = 0; ilength < nlengthUnits; ++ilength)
+      {
+         if (unitlS == lengthUnits[ilength].name)
+         {
+            scale.length = lengthUnits[ilength].scale.length;
+            break;
+         }
+      }
+      if (ilength == nlengthUnits)
+      {
+         XString tagS(el->getTagName());
+         std::cerr
+              << APP_NAME << " error: unknown length unit " << S(unitlS)
+              << " on tag " << S(tagS) << std::endl;
+         exit(1);
+      }
    }
 
-   XString unitaS = el->getAttribute(X("unit_angle"));
-   if (unitaS.size() == 0)
+   int iangle = -1;
+   if (unitaS.size() != 0)
    {
-      ;
-   }
-   else if (unitaS == "deg")
-   {
-      set_1deg(1);
-   }
-   else if (unitaS == "rad")
-   {
-      set_1rad(1);
-   }
-   else if (unitaS == "mrad")
-   {
-      set_1rad(1e3);
-   }
-   else
-   {
-      XString tagS(el->getTagName());
-      std::cerr
-           << APP_NAME << " error: unknown angle unit " << S(unitaS)
-           << " on volume " << S(tagS) << std::endl;
-      exit(1);
+      for (iangle = 0; iangle < nangleUnits; ++iangle)
+      {
+         if (unitaS == angleUnits[iangle].name)
+         {
+            scale.angle = angleUnits[iangle].scale.angle;
+            scale.angleInDeg = angleUnits[iangle].scale.angleInDeg;
+            break;
+         }
+      }
+      if (iangle == nangleUnits)
+      {
+         XString tagS(el->getTagName());
+         std::cerr
+              << APP_NAME << " error: unknown angle unit " << S(unitaS)
+              << " on volume " << S(tagS) << std::endl;
+         exit(1);
+      }
    }
 
-   XString unitS = el->getAttribute(X("unit"));
-   if (unitS.size() == 0)
-   {
-      ;
-   }
-   else if (unitS == "mm")
-   {
-      set_1cm(10);
-   }
-   else if (unitS == "cm")
-   {
-      set_1cm(1);
-   }
-   else if (unitS == "m")
-   {
-      set_1cm(0.01);
-   }
-   else if (unitlS == "km")
+   if (unitS.size() != 0)
    {
-      set_1cm(1e-5);
+      int iunit;
+      for (iunit = 0; iunit < notherUnits; ++iunit)
+      {
+         if (unitS == otherUnits[iunit].name)
+         {
+            break;
+         }
+      }
+
+      // Only a length unit in the unit attribute overrides unit_length.
+      // Otherwise the unit attribute is ignored when unit_length is
+      // something other than mm, cm or m, or when unit_angle is present.
+      // This keeps the precedence that the original if-chain had.
+      if (iunit < notherUnits && otherUnits[iunit].scale.length != 0)
+      {
+         scale.length = otherUnits[iunit].scale.length;
+      }
+      else if (ilength >= 3 || iangle >= 0)
+      {
+         ;
+      }
+      else if (iunit < notherUnits)
+      {
+         const Scale& other = otherUnits[iunit].scale;
+         scale.energy = (other.energy != 0)? other.energy : scale.energy;
+         scale.mass = (other.mass != 0)? other.mass : scale.mass;
+         scale.area = (other.area != 0)? other.area : scale.area;
+         scale.volume = (other.volume != 0)? other.volume : scale.volume;
+         scale.field = (other.field != 0)? other.field : scale.field;
+      }
+      else
+      {
+         XString tagS(el->getTagName());
+         std::cerr
+              << APP_NAME << " error: unknown unit " << S(unitS)
+              << " on volume " << S(tagS) << std::endl;
+         exit(1);
+      }
    }
-   else if (unitlS == "um")
+   return fScales[key] = scale;
+}
+
+void Units::apply(const Scale& scale)
+{
+   if (scale.length != 0)
    {
-      set_1cm(1e6);
+      set_1cm(scale.length);
    }
-   else if (unitlS == "nm")
+   if (scale.angle != 0)
    {
-      set_1cm(1e9);
+      if (scale.angleInDeg)
+      {
+         set_1deg(scale.angle);
+      }
+      else
+      {
+         set_1rad(scale.angle);
+      }
    }
-   else if (unitlS == "in")
+   if (scale.energy != 0)
    {
-      set_1cm(1/2.54);
+      set_1MeV(scale.energy);
    }
-   else if (unitlS == "ft")
+   if (scale.mass != 0)
    {
-      set_1cm(1/(12*2.54));
+      set_1g(scale.mass);
    }
-   else if (unitlS == "mil")
+   if (scale.area != 0)
    {
-      set_1cm(1000/2.54);
+      set_1cm2(scale.area);
    }
-   else if (unitaS == "deg")
+   if (scale.volume != 0)
    {
-      set_1deg(1);
+      set_1cm3(scale.volume);
    }
-   else if (unitaS == "rad")
+   if (scale.field != 0)
    {
-      set_1rad(1);
+      set_1G(scale.field);
    }
-   else if (unitaS == "mrad")
+}
+
+void Units::getConversions(DOMElement* el)
+{
+   apply(resolve(el));
+}
+
+const Units& Units::forElement(DOMElement* el)
+{
+   std::map<const DOMElement*,Units>::iterator iter = fElementUnits.find(el);
+   if (iter != fElementUnits.end())
    {
-      set_1rad(1e3);
+      return iter->second;
    }
-   else if (unitS == "eV")
+   Units& unit = fElementUnits[el];
+   unit.getConversions(el);
+   return unit;
+}
+
+void Units::clearCache()
+{
+   fElementUnits.clear();
+}
+
+/* AttributeDecoder class:
+ *	Decodes numeric attribute lists once per element and keeps the
+ *	results for the rest of the translation.
+ */
+
+std::map<AttributeDecoder::Key,std::vector<double> > AttributeDecoder::fCache;
+
+double AttributeDecoder::parseDouble(const char* str, const char** end)
+{
+   // Up to 15 significant digits and a decimal exponent of at most 22
+   // the value is an exact double times an exact power of ten, so one
+   // multiplication or division gives the correctly rounded result.
+   // Longer numbers go to the (slower) classic-locale stream parser.
+
+   static const double pow10[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9, 1e10,
+      1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+      1e21, 1e22
+   };
+
+   const char* p = str;
+   while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
    {
-      set_1MeV(1e6);
+      ++p;
    }
-   else if (unitS == "KeV")
+   const char* start = p;
+   bool negative = (*p == '-');
+   if (*p == '-' || *p == '+')
    {
-      set_1MeV(1e3);
+      ++p;
    }
-   else if (unitS == "MeV")
+
+   double mantissa = 0;
+   int ndigits = 0;
+   int exp10 = 0;
+   bool digits = false;
+   bool exact = true;
+   for (; *p >= '0' && *p <= '9'; ++p)
    {
-      set_1MeV(1);
+      digits = true;
+      if (ndigits < 15)
+      {
+         mantissa = mantissa * 10 + (*p - '0');
+         ndigits += (mantissa > 0);
+      }
+      else
+      {
+         ++exp10;
+         exact &= (*p == '0');
+      }
    }
-   else if (unitS == "GeV")
+   if (*p == '.')
    {
-      set_1MeV(1e-3);
+      for (++p; *p >= '0' && *p <= '9'; ++p)
+      {
+         digits = true;
+         if (ndigits < 15)
+         {
+            mantissa = mantissa * 10 + (*p - '0');
+            ndigits += (mantissa > 0);
+            --exp10;
+         }
+         else
+         {
+            exact &= (*p == '0');
+         }
+      }
    }
-   else if (unitS == "g/cm^2")
+   if (! digits)
    {
-      set_1g(1);
-      set_1cm2(1);
+      *end = str;
+      return 0;
    }
-   else if (unitS == "g/cm^3")
+   if (*p == 'e' || *p == 'E')
    {
-      set_1g(1);
-      set_1cm3(1);
+      const char* q = p + 1;
+      bool negexp = (*q == '-');
+      if (*q == '-' || *q == '+')
+      {
+         ++q;
+      }
+      if (*q >= '0' && *q <= '9')
+      {
+         int e = 0;
+         for (; *q >= '0' && *q <= '9'; ++q)
+         {
+            e = (e < 10000)? e * 10 + (*q - '0') : e;
+         }
+         exp10 += (negexp)? -e : e;
+         p = q;
+      }
    }
-   else if (unitS == "MeV/g/cm^2")
+   *end = p;
+
+   double result = 0;
+   if (exact && exp10 >= -22 && exp10 <= 22)
    {
-      set_1MeV(1);
-      set_1g(1);
-      set_1cm2(1);
+      result = (exp10 < 0)? mantissa / pow10[-exp10] : mantissa * pow10[exp10];
+      return (negative)? -result : result;
    }
-   else if (unitS == "Tesla" || unitS == "T")
+   std::istringstream slow(std::string(start, p));
+   slow.imbue(std::locale::classic());
+   slow >> result;
+   return result;
+}
+
+const std::vector<double>& AttributeDecoder::values(DOMElement* el,
+                                                    const char* attr,
+                                                    const char* dims)
+{
+   Key key(el, attr);
+   if (dims)
    {
-      set_1G(1e-4);
+      key.second += "/";
+      key.second += dims;
    }
-   else if (unitS == "kG" || unitS == "kGs")
+   std::map<Key,std::vector<double> >::iterator iter = fCache.find(key);
+   if (iter != fCache.end())
    {
-      set_1G(1e-3);
+      return iter->second;
    }
-   else if (unitS == "G" || unitS == "Gs")
+
+   std::vector<double>& vals = fCache[key];
+   XString valS(el->getAttribute(X(attr)));
+   const char* str = valS.c_str();
+   const char* end;
+   for (double v = parseDouble(str, &end); end != str;
+        v = parseDouble(str, &end))
    {
-      set_1G(1);
+      vals.push_back(v);
+      str = end;
    }
-   else if (unitS == "percent")
+
+   if (dims && dims[0] != 0 && vals.size() > 0)
    {
-      ;
+      const Units& unit = Units::forElement(el);
+      int ndims = strlen(dims);
+      for (unsigned int i = 0; i < vals.size(); i++)
+      {
+         switch (dims[(i < (unsigned int)ndims)? i : ndims - 1])
+         {
+            case 'l':
+               vals[i] /= unit.cm;
+               break;
+            case 'a':
+               vals[i] /= unit.rad;
+               break;
+            case 'd':
+               vals[i] /= unit.deg;
+               break;
+            default:
+               break;
+         }
+      }
    }
-   else if (unitS == "none")
+   return vals;
+}
+
+int AttributeDecoder::get(DOMElement* el, const char* attr,
+                          double* v, int n, const char* dims)
+{
+   const std::vector<double>& vals = values(el, attr, dims);
+   for (int i = 0; i < n; i++)
    {
-      ;
+      v[i] = (i < (int)vals.size())? vals[i] : 0;
    }
-   else
+   return vals.size();
+}
+
+double AttributeDecoder::value(DOMElement* el, const char* attr,
+                               const char* dims)
+{
+   const std::vector<double>& vals = values(el, attr, dims);
+   return (vals.size() > 0)? vals[0] : 0;
+}
+
+void AttributeDecoder::forget(DOMElement* el, const char* attr)
+{
+   // drops the plain values together with those decoded for any dims
+   std::string name(attr);
+   std::map<Key,std::vector<double> >::iterator iter;
+   iter = fCache.lower_bound(Key(el,name));
+   while (iter != fCache.end() && iter->first.first == el &&
+          iter->first.second.compare(0, name.size(), name) == 0)
    {
-      XString tagS(el->getTagName());
-      std::cerr
-           << APP_NAME << " error: unknown unit " << S(unitS)
-           << " on volume " << S(tagS) << std::endl;
-      exit(1);
+      const std::string& keyS = iter->first.second;
+      if (keyS.size() == name.size() || keyS[name.size()] == '/')
+      {
+         fCache.erase(iter++);
+      }
+      else
+      {
+         ++iter;
+      }
    }
 }
 
+void AttributeDecoder::clear()
+{
+   fCache.clear();
+}
+
 #ifdef LINUX_CPUTIME_PROFILING
 CPUtimer::CPUtimer()
 {
@@ -1111,114 +1672,118 @@ CPUtimer timer;
 
 int CodeWriter::createMaterial(DOMElement* el)
 {
-   static int imateCount = 0;
-   int imate = ++imateCount;
-   std::stringstream imateStr;
-   imateStr << imate;
-   el->setAttribute(X("HDDSmate"),X(imateStr.str()));
+   int imate = ++fContext.fMaterialCount;
+   fContext.fTable[el].mate = imate;
 
-   Substance subst(el);
-   std::list<Substance::Brew>::iterator iter;
+   const Substance& subst = MaterialRegistry::get(el);
+   std::list<Substance::Brew>::const_iterator iter;
    for (iter = subst.fBrewList.begin();
         iter != subst.fBrewList.end(); ++iter)
    {
       DOMElement* subEl = iter->sub->getDOMElement();
-      XString subS(subEl->getAttribute(X("HDDSmate")));
-      iter->sub->fUniqueID = atoi(S(subS));
-      if (iter->sub->fUniqueID == 0)
+      if (fContext.fTable[subEl].mate == 0)
       {
-         iter->sub->fUniqueID = createMaterial(subEl);
+         createMaterial(subEl);
       }
    }
    fSubst = subst;
+   fSubst.fUniqueID = imate;
    return imate;
 }
 
 int CodeWriter::createSolid(DOMElement* el, Refsys& ref)
 {
+   NOT_USED(ref);
+
    XString nameS(el->getAttribute(X("name")));
    XString matS(el->getAttribute(X("material")));
 
    DOMDocument* document = el->getOwnerDocument();
-   DOMElement* matEl = document->getElementById(X(matS));
-   XString imateS(matEl->getAttribute(X("HDDSmate")));
-   if (imateS.size() != 0)
+   DOMElement* matEl = loadElementById(document, matS);
+   int imate = fContext.fTable[matEl].mate;
+   if (imate != 0)
    {
-      fSubst.fUniqueID = atoi(S(imateS));
+      fSubst.fUniqueID = imate;
    }
    else
    {
       fSubst.fUniqueID = createMaterial(matEl);
    }
    
-   int ivolu = ref.nextVolumeID();
-   std::stringstream ivoluStr;
-   ivoluStr << ivolu;
-   el->setAttribute(X("HDDSvolu"),X(ivoluStr.str()));  
-   el->setAttribute(X("HDDScopy"),X("0"));  
+   int ivolu = fContext.nextVolumeID();
+   ElementTable::Entry& entry = fContext.fTable[el];
+   entry.volu = ivolu;
+   entry.copy = 0;
 
    return ivolu;
 }
 
 int CodeWriter::createRotation(Refsys& ref)
 {
+   fNewRotation = false;
    if (ref.fRotation < 0)
    {
-      ref.fRotation = ref.nextRotationID();
+      RotationRegistry::snap(ref.fRmatrix);
+      if (RotationRegistry::isIdentity(ref.fRmatrix))
+      {
+         ref.fRotation = 0;
+      }
+      else if ((ref.fRotation =
+                fContext.fRotationTable.find(ref.fRmatrix)) == 0)
+      {
+         ref.fRotation = fContext.nextRotationID();
+         fContext.fRotationTable.insert(ref.fRmatrix, ref.fRotation);
+         fNewRotation = true;
+      }
    }
    return ref.fRotation;
 }
 
+static double asWritten(double value)
+{
+   // Region maps and profiles used to be stored as attributes, written
+   // with the default stream precision, and the generated code has always
+   // been printed from the values read back.  Keep that rounding.
+
+   std::stringstream str;
+   str << value;
+   const char* end;
+   return AttributeDecoder::parseDouble(str.str().c_str(), &end);
+}
+
 int CodeWriter::createRegion(DOMElement* el, Refsys& ref)
 {
-   int iregion = ref.nextRegionID();
+   int iregion = fContext.nextRegionID();
 
    XString regionS(el->getAttribute(X("region")));
    DOMDocument* document = el->getOwnerDocument();
-   ref.fRegion = document->getElementById(X(regionS));
+   ref.fRegion = loadElementById(document, regionS);
    ref.fRegionID = iregion;
 
    double origin[3], angle[3];
-   XString rotS(el->getAttribute(X("rot")));
-   std::stringstream listr(rotS);
-   listr >> angle[0] >> angle[1] >> angle[2];
-   Units unit;
-   unit.getConversions(el);
+   AttributeDecoder::get(el, "rot", angle, 3);
+   const Units& unit = Units::forElement(el);
    angle[0] /= unit.rad;
    angle[1] /= unit.rad;
    angle[2] /= unit.rad;
-   XString xyzS(el->getAttribute(X("origin")));
-   listr.clear(), listr.str(xyzS);
-   listr >> origin[0] >> origin[1] >> origin[2];
+   AttributeDecoder::get(el, "origin", origin, 3);
    origin[0] /= unit.cm;
    origin[1] /= unit.cm;
    origin[2] /= unit.cm;
    ref.shift(origin);
    ref.rotate(angle);
 
-   std::stringstream attStr;
-   attStr << iregion;
-   el->setAttribute(X("HDDSregion"),X(attStr.str()));
-   DOMElement* regEl = document->createElement(X("HDDSregion"));
-   regEl->setAttribute(X("id"),X(attStr.str()));
-
-   attStr.clear(), attStr.str("");
-   attStr << ref.fMOrigin[0] << " "
-          << ref.fMOrigin[1] << " " 
-          << ref.fMOrigin[2];
-   regEl->setAttribute(X("origin"),X(attStr.str()));
-   attStr.clear(), attStr.str("");
-   attStr << ref.fMRmatrix[0][0] << " "
-          << ref.fMRmatrix[0][1] << " "
-          << ref.fMRmatrix[0][2] << " "
-          << ref.fMRmatrix[1][0] << " "
-          << ref.fMRmatrix[1][1] << " "
-          << ref.fMRmatrix[1][2] << " "
-          << ref.fMRmatrix[2][0] << " "
-          << ref.fMRmatrix[2][1] << " "
-          << ref.fMRmatrix[2][2];
-   regEl->setAttribute(X("Rmatrix"),X(attStr.str()));
-   ref.fRegion->appendChild(regEl);
+   fContext.fTable[el].region = iregion;
+   ElementTable::RegionMap map;
+   map.id = iregion;
+   for (int i = 0; i < 3; i++)
+   {
+      map.origin[i] = asWritten(ref.fMOrigin[i]);
+      map.Rmatrix[i][0] = asWritten(ref.fMRmatrix[i][0]);
+      map.Rmatrix[i][1] = asWritten(ref.fMRmatrix[i][1]);
+      map.Rmatrix[i][2] = asWritten(ref.fMRmatrix[i][2]);
+   }
+   fContext.fTable[ref.fRegion].maps.push_back(map);
 
    for (DOMNode* cont = ref.fRegion->getFirstChild();
         cont != 0;
@@ -1229,7 +1794,7 @@ int CodeWriter::createRegion(DOMElement* el, Refsys& ref)
          XString tagS(((DOMElement*)cont)->getTagName());
          if (tagS.find("Bfield") != XString::npos)
          {
-            ref.addIdentifier(XString("map"),iregion,0);
+            addIdentifier(ref,XString("map"),iregion,0);
             break;
          }
       }
@@ -1240,25 +1805,14 @@ int CodeWriter::createRegion(DOMElement* el, Refsys& ref)
 int CodeWriter::createDivision(XString& divStr, Refsys& ref)
 {
    int ncopy = ref.fPartition.ncopy;
-   int ivolu = ref.nextVolumeID();
+   int ivolu = fContext.nextVolumeID();
 
    assert (ref.fMother != 0);
 
-   std::stringstream attStr;
-   DOMDocument* document = ref.fMother->getOwnerDocument();
-   DOMElement* divEl = document->createElement(X("HDDSdivision"));
-   divEl->setAttribute(X("name"),X(divStr));
-   XString motherS(ref.fMother->getAttribute(X("name")));
-   divEl->setAttribute(X("volume"),X(motherS));
-   attStr << ivolu;
-   divEl->setAttribute(X("HDDSvolu"),X(attStr.str()));  
-   std::stringstream copyStr;
-   copyStr << ncopy;
-   divEl->setAttribute(X("HDDScopy"),X(copyStr.str()));  
-   ref.fMother->appendChild(divEl);
-   ref.fPartition.divEl = divEl;
+   fContext.fDivisionNames.push_back(divStr);
+   ref.fPartition.divName = &fContext.fDivisionNames.back();
 
-   std::map<std::string,Refsys::VolIdent>::iterator iter;
+   std::map<std::string,Refsys::VolIdent>::const_iterator iter;
    for (iter = ref.fIdentifier.begin();
         iter != ref.fIdentifier.end();
         ++iter)
@@ -1266,24 +1820,44 @@ int CodeWriter::createDivision(XString& divStr, Refsys& ref)
       int value = iter->second.value;
       int step = iter->second.step;
       XString fieldS(iter->first);
-      std::vector<int>* idlist = &Refsys::fIdentifierTable[ivolu][fieldS];
+      std::vector<int>* idlist = &fContext.fIdentifierTable[ivolu][fieldS];
       for (int ic = 0; ic < ncopy; ic++)
       {
          idlist->push_back(value);
          value += step;
       }
    }
-   Refsys::fIdentifierTable[ivolu]["copy counter"].push_back(ncopy);
+   fContext.fIdentifierTable[ivolu]["copy counter"].push_back(ncopy);
    ref.clearIdentifiers();
    return ncopy;
 }
 
+HddsTag hddsTag(const DOMElement* el)
+{
+   static const XName tags[] = {
+      "", "composition", "intersection", "subtraction", "union",
+      "stackX", "stackY", "stackZ", "posXYZ", "posRPhiZ",
+      "mposPhi", "mposR", "mposX", "mposY", "mposZ", "apply"
+   };
+   static const int ntags = sizeof(tags)/sizeof(tags[0]);
+
+   const XMLCh* tag = el->getTagName();
+   for (int i = 1; i < ntags; i++)
+   {
+      if (XMLString::equals(tag, tags[i]))
+      {
+         return (HddsTag)i;
+      }
+   }
+   return kUnknownTag;
+}
+
 int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
 {
    fPending = false;
    int icopy = 0;
 
-   XString tagS(el->getTagName());
+   HddsTag tag = hddsTag(el);
    XString nameS(el->getAttribute(X("name")));
 
    Refsys myRef(ref);
@@ -1292,8 +1866,8 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
    XString envS(el->getAttribute(X("envelope")));
    if (envS.size() != 0)
    {
-      env = document->getElementById(X(envS));
-      XString containS(env->getAttribute(X("contains")));
+      env = loadElementById(document, envS);
+      std::string containS(fContext.fTable[env].contains);
       if (containS == nameS)
       {
          return createVolume(env,myRef);
@@ -1316,8 +1890,7 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             continue;
          }
          DOMElement* contEl = (DOMElement*) cont;
-         XString comdS(contEl->getTagName());
-         if (comdS == "apply")
+         if (hddsTag(contEl) == kApplyTag)
          {
             Refsys drs(myRef);
             myRef.fRegionID = createRegion(contEl,drs);
@@ -1327,23 +1900,25 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
          }
       }
 
-      env->setAttribute(X("contains"),X(nameS));
+      fContext.fTable[env].contains = nameS;
       icopy = createVolume(env,myRef);
       myRef.clearIdentifiers();
       myRef.fMother = env;
+      myRef.fDivision = 0;
       myRef.reset();
    }
 
-   if (tagS == "intersection" ||
-       tagS == "subtraction" ||
-       tagS == "union")
+   if (tag == kIntersectionTag ||
+       tag == kSubtractionTag ||
+       tag == kUnionTag)
    {
+      XString tagS(el->getTagName());
       std::cerr
            << APP_NAME << " error: boolean " << S(tagS)
            << " operator is not supported by "<< APP_NAME << std::endl;
       exit(1);
    }
-   else if (tagS == "composition")
+   else if (tag == kCompositionTag)
    {
       DOMNode* cont;
       int nSiblings = 0;
@@ -1366,17 +1941,14 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             continue;
          }
          DOMElement* contEl = (DOMElement*) cont;
-         XString comdS(contEl->getTagName());
+         HddsTag comd = hddsTag(contEl);
          XString targS(contEl->getAttribute(X("volume")));
-         DOMElement* targEl = document->getElementById(X(targS));
+         DOMElement* targEl = loadElementById(document, targS);
 
          Refsys drs(myRef);
          double origin[3], angle[3];
-         XString rotS(contEl->getAttribute(X("rot")));
-         std::stringstream listr1(rotS);
-         listr1 >> angle[0] >> angle[1] >> angle[2];
-         Units unit;
-         unit.getConversions(contEl);
+         AttributeDecoder::get(contEl, "rot", angle, 3);
+         const Units& unit = Units::forElement(contEl);
          angle[0] /= unit.rad;
          angle[1] /= unit.rad;
          angle[2] /= unit.rad;
@@ -1397,26 +1969,16 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             XString fieldS(identEl->getAttribute(X("field")));
             XString valueS(identEl->getAttribute(X("value")));
             XString stepS(identEl->getAttribute(X("step")));
-            drs.addIdentifier(fieldS,atoi(S(valueS)),atoi(S(stepS)));
+            addIdentifier(drs,fieldS,atoi(S(valueS)),atoi(S(stepS)));
          }
 
-         XString geolayerS(contEl->getAttribute(X("geometry_layer")));
-         if (geolayerS.size() != 0)
-         {
-            std::stringstream geolayerStr(geolayerS);
-            geolayerStr >> drs.fRelativeLayer;
-         }
-         else
-         {
-            drs.fRelativeLayer = 0;
-         }
+         drs.fRelativeLayer = (int)AttributeDecoder::value(contEl,
+                                                           "geometry_layer");
          drs.fGeometryLayer += drs.fRelativeLayer;
 
-         if (comdS == "posXYZ")
+         if (comd == kPosXYZTag)
          {
-            XString xyzS(contEl->getAttribute(X("X_Y_Z")));
-            std::stringstream listr(xyzS);
-            listr >> origin[0] >> origin[1] >> origin[2];
+            AttributeDecoder::get(contEl, "X_Y_Z", origin, 3);
             origin[0] /= unit.cm;
             origin[1] /= unit.cm;
             origin[2] /= unit.cm;
@@ -1424,15 +1986,12 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             drs.rotate(angle);
             createVolume(targEl,drs);
          }
-         else if (comdS == "posRPhiZ")
+         else if (comd == kPosRPhiZTag)
          {
             double r, phi, z;
-            XString rphizS(contEl->getAttribute(X("R_Phi_Z")));
-            std::stringstream listr(rphizS);
-            listr >> r >> phi >> z;
+            AttributeDecoder::get(contEl, "R_Phi_Z", r, phi, z);
             double s;
-            XString sS(contEl->getAttribute(X("S")));
-            s = atof(S(sS));
+            s = AttributeDecoder::value(contEl, "S");
             phi /= unit.rad;
             r /= unit.cm;
             z /= unit.cm;
@@ -1449,7 +2008,7 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             drs.rotate(angle);
             createVolume(targEl,drs);
          }
-         else if (comdS == "mposPhi")
+         else if (comd == kMposPhiTag)
          {
             XString ncopyS(contEl->getAttribute(X("ncopy")));
             int ncopy = atoi(S(ncopyS));
@@ -1463,12 +2022,10 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
 
             double phi0, dphi;
-            XString phi0S(contEl->getAttribute(X("Phi0")));
-            phi0 = atof(S(phi0S)) /unit.rad;
-            XString dphiS(contEl->getAttribute(X("dPhi")));
-            if (dphiS.size() != 0)
+            phi0 = AttributeDecoder::value(contEl, "Phi0") /unit.rad;
+            if (AttributeDecoder::values(contEl, "dPhi").size() != 0)
             {
-               dphi = atof(S(dphiS)) /unit.rad;
+               dphi = AttributeDecoder::value(contEl, "dPhi") /unit.rad;
             }
             else
             {
@@ -1476,11 +2033,8 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
 
             double r, s, z;
-            XString rzS(contEl->getAttribute(X("R_Z")));
-            std::stringstream listr(rzS);
-            listr >> r >> z;
-            XString sS(contEl->getAttribute(X("S")));
-            s = atof(S(sS));
+            AttributeDecoder::get(contEl, "R_Z", r, z);
+            s = AttributeDecoder::value(contEl, "S");
             r /= unit.cm;
             z /= unit.cm;
             s /= unit.cm;
@@ -1494,9 +2048,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               containerS = el->getAttribute(X("container_name"));
-               containerTypeS = el->getAttribute(X("container_type"));
-               env = document->getElementById(X(containerS));
+               containerS = fContext.fTable[el].containerName;
+               containerTypeS = fContext.fTable[el].containerType;
+               env = loadElementById(document, containerS);
             }
             XString implrotS(contEl->getAttribute(X("impliedRot")));
             XString targTagS(targEl->getTagName());
@@ -1504,7 +2058,7 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             DOMElement* targEnv;
             if (targEnvS.size() != 0)
             {
-               targEnv = document->getElementById(X(targEnvS));
+               targEnv = loadElementById(document, targEnvS);
             }
             else
             {
@@ -1517,15 +2071,11 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                 (implrotS == "true"))
             {
                double phiMax, phiMin, dphiM;
-               XString envProfS(env->getAttribute(X("profile")));
-               if (envProfS.size() > 0)
+               double prof[2];
+               if (getProfile(env, prof, "d") > 0)
                {
-                  std::stringstream profstr(envProfS);
-                  profstr >> phiMin >> dphiM;
-                  Units munit;
-                  munit.getConversions(env);
-                  phiMin /= munit.deg;
-                  dphiM /= munit.deg;
+                  phiMin = prof[0];
+                  dphiM = prof[1];
                   phiMax = phiMin + dphiM;
                }
                else {
@@ -1553,15 +2103,12 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                   exit(1);
                }
                double phi1=0, dphi1=0;
-               XString targProfS(targEnv->getAttribute(X("profile")));
-               if (r == 0 && s == 0 && targProfS.size() > 0)
+               if (r == 0 && s == 0)
                {
-                  std::stringstream profstr(targProfS);
-                  profstr >> phi1 >> dphi1;
-                  Units tunit;
-                  tunit.getConversions(targEnv);
-                  phi1 /= tunit.deg;
-                  dphi1 /= tunit.deg;
+                  double tprof[2];
+                  getProfile(targEnv, tprof, "d");
+                  phi1 = tprof[0];
+                  dphi1 = tprof[1];
                }
                if (phipull+phi1 < -0.001 || phipull+phi1+dphi1 > dphi+0.001)
                {
@@ -1572,10 +2119,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                        << std::endl;
                   exit(1);
                }
-               static int phiDivisions = 0xd00;
                std::stringstream divStr;
                divStr << "s" << std::setfill('0') << std::setw(3) << std::hex
-                      << ++phiDivisions;
+                      << ++fContext.fPhiDivisions;
                drs.fPartition.ncopy = ncopy;
                drs.fPartition.axis = "phi";
                drs.fPartition.start = phi0 - phipull - myRef.fPhiOffset;
@@ -1583,9 +2129,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                drs.fPartition.step = dphi;
                XString divS(divStr.str());
                createDivision(divS, drs);
-               drs.fMother = drs.fPartition.divEl;
-               targEl->setAttribute(X("container_name"),X(containerS));
-               targEl->setAttribute(X("container_type"),X(containerTypeS));
+               drs.fDivision = drs.fPartition.divName;
+               fContext.fTable[targEl].containerName = containerS;
+               fContext.fTable[targEl].containerType = containerTypeS;
                drs.reset();
 
                double phioffset = dphi/2 - phipull;
@@ -1604,26 +2150,18 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               Refsys drs0(drs);
+               std::vector<Refsys::Placement> series;
+               bool rotated = Refsys::placeCopies(drs, contEl, angle, series);
                drs.rotate(angle);
                for (int inst = 0; inst < ncopy; inst++)
                {
-                  double phi = phi0 + inst * dphi;
-                  origin[0] = r * cos(phi) - s * sin(phi);
-                  origin[1] = r * sin(phi) + s * cos(phi);
-                  origin[2] = z;
-                  drs.shift(drs0, origin);
-                  if (implrotS == "true")
-                  {
-                     angle[2] += ((inst == 0) ? phi0 : dphi);
-                     drs.rotate(drs0, angle);
-                  }
+                  drs.place(series[inst], rotated);
                   createVolume(targEl,drs);
                   drs.incrementIdentifiers();
                }
             }
          }
-         else if (comdS == "mposR")
+         else if (comd == kMposRTag)
          {
             XString ncopyS(contEl->getAttribute(X("ncopy")));
             int ncopy = atoi(S(ncopyS));
@@ -1637,17 +2175,12 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
 
             double r0, dr;
-            XString r0S(contEl->getAttribute(X("R0")));
-            r0 = atof(S(r0S)) /unit.cm;
-            XString drS(contEl->getAttribute(X("dR")));
-            dr = atof(S(drS)) /unit.cm;
+            r0 = AttributeDecoder::value(contEl, "R0") /unit.cm;
+            dr = AttributeDecoder::value(contEl, "dR") /unit.cm;
 
             double phi, z, s;
-            XString zphiS(contEl->getAttribute(X("Z_Phi")));
-            std::stringstream listr(zphiS);
-            listr >> z >> phi;
-            XString sS(contEl->getAttribute(X("S")));
-            s = atof(S(sS));
+            AttributeDecoder::get(contEl, "Z_Phi", z, phi);
+            s = AttributeDecoder::value(contEl, "S");
             phi /= unit.rad;
             z /= unit.cm;
             s /= unit.cm;
@@ -1661,21 +2194,17 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               containerS = el->getAttribute(X("container_name"));
-               containerTypeS = el->getAttribute(X("container_type"));
-               env = document->getElementById(X(containerS));
+               containerS = fContext.fTable[el].containerName;
+               containerTypeS = fContext.fTable[el].containerType;
+               env = loadElementById(document, containerS);
             }
             if (noRotation && (nSiblings == 1) &&
                 (containerTypeS == "tubs" ))
             {
                double rMax, rMin;
-               XString envRioZS(env->getAttribute(X("Rio_Z")));
-               if (envRioZS.size() > 0)
+               if (AttributeDecoder::get(env, "Rio_Z", rMin, rMax) > 0)
                {
-                  std::stringstream riozstr(envRioZS);
-                  riozstr >> rMin >> rMax;
-                  Units munit;
-                  munit.getConversions(env);
+                  const Units& munit = Units::forElement(env);
                   rMin /= munit.deg;
                   rMax /= munit.deg;
                   // drM = rMax-rMin;  commented out to avoid compiler warnings 4/26/2015 DL
@@ -1688,10 +2217,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                        << std::endl;
                   exit(1);
                }
-               static int rDivisions = 0xd00;
                std::stringstream divStr;
                divStr << "r" << std::setfill('0') << std::setw(3) << std::hex
-                      << ++rDivisions;
+                      << ++fContext.fRDivisions;
                drs.fPartition.ncopy = ncopy;
                drs.fPartition.axis = "rho";
                drs.fPartition.start = r0 - dr/2;
@@ -1699,9 +2227,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                drs.fPartition.step = dr;
                XString divS(divStr.str());
                createDivision(divS, drs);
-               drs.fMother = drs.fPartition.divEl;
-               targEl->setAttribute(X("container_name"),X(containerS));
-               targEl->setAttribute(X("container_type"),X(containerTypeS));
+               drs.fDivision = drs.fPartition.divName;
+               fContext.fTable[targEl].containerName = containerS;
+               fContext.fTable[targEl].containerType = containerTypeS;
                origin[0] = r0 * cos(phi) - s * sin(phi);
                origin[1] = r0 * sin(phi) + s * cos(phi);
                origin[2] = z;
@@ -1712,21 +2240,18 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               Refsys drs0(drs);
+               std::vector<Refsys::Placement> series;
+               bool rotated = Refsys::placeCopies(drs, contEl, angle, series);
                drs.rotate(angle);
                for (int inst = 0; inst < ncopy; inst++)
                {
-                  double r = r0 + inst * dr;
-                  origin[0] = r * cos(phi) - s * sin(phi);
-                  origin[1] = r * sin(phi) + s * cos(phi);
-                  origin[2] = z;
-                  drs.shift(drs0, origin);
+                  drs.place(series[inst], rotated);
                   createVolume(targEl,drs);
                   drs.incrementIdentifiers();
                }
             }
          }
-         else if (comdS == "mposX")
+         else if (comd == kMposXTag)
          {
             XString ncopyS(contEl->getAttribute(X("ncopy")));
             int ncopy = atoi(S(ncopyS));
@@ -1740,17 +2265,12 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
 
             double x0, dx;
-            XString x0S(contEl->getAttribute(X("X0")));
-            x0 = atof(S(x0S)) /unit.cm;
-            XString dxS(contEl->getAttribute(X("dX")));
-            dx = atof(S(dxS)) /unit.cm;
+            x0 = AttributeDecoder::value(contEl, "X0") /unit.cm;
+            dx = AttributeDecoder::value(contEl, "dX") /unit.cm;
 
             double y, z, s;
-            XString yzS(contEl->getAttribute(X("Y_Z")));
-            std::stringstream listr(yzS);
-            listr >> y >> z;
-            XString sS(contEl->getAttribute(X("S")));
-            s = atof(S(sS));
+            AttributeDecoder::get(contEl, "Y_Z", y, z);
+            s = AttributeDecoder::value(contEl, "S");
             y /= unit.cm;
             z /= unit.cm;
             s /= unit.cm;
@@ -1764,23 +2284,18 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               containerS = el->getAttribute(X("container_name"));
-               containerTypeS = el->getAttribute(X("container_type"));
-               env = document->getElementById(X(containerS));
+               containerS = fContext.fTable[el].containerName;
+               containerTypeS = fContext.fTable[el].containerType;
+               env = loadElementById(document, containerS);
             }
             if (noRotation && (nSiblings == 1) && 
                 containerTypeS == "box")
             {
                double xMax, xMin;
-               XString envXYZS(env->getAttribute(X("X_Y_Z")));
-               if (envXYZS.size() > 0)
+               double hxyz[3];
+               if (AttributeDecoder::get(env, "X_Y_Z", hxyz, 3, "l") > 0)
                {
-                  std::stringstream xyzstr(envXYZS);
-                  double hx, hy, hz;
-                  xyzstr >> hx >> hy >> hz;
-                  Units munit;
-                  munit.getConversions(env);
-                  xMax = hx/2 /munit.cm;
+                  xMax = hxyz[0]/2;
                   xMin = -xMax;
                   // dxM = hx;  commented out to avoid compiler warnings 4/26/2015 DL
                }
@@ -1792,10 +2307,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                        << std::endl;
                   exit(1);
                }
-               static int xDivisions = 0xd00;
                std::stringstream divStr;
                divStr << "x" << std::setfill('0') << std::setw(3) << std::hex
-                      << ++xDivisions;
+                      << ++fContext.fXDivisions;
                drs.fPartition.ncopy = ncopy;
                drs.fPartition.axis = "x";
                drs.fPartition.start = x0 - dx/2;
@@ -1803,9 +2317,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                drs.fPartition.step = dx;
                XString divS(divStr.str());
                createDivision(divS, drs);
-               drs.fMother = drs.fPartition.divEl;
-               targEl->setAttribute(X("container_name"),X(containerS));
-               targEl->setAttribute(X("container_type"),X(containerTypeS));
+               drs.fDivision = drs.fPartition.divName;
+               fContext.fTable[targEl].containerName = containerS;
+               fContext.fTable[targEl].containerType = containerTypeS;
                origin[0] = 0;
                origin[1] = y + s;
                origin[2] = z;
@@ -1816,21 +2330,18 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               Refsys drs0(drs);
+               std::vector<Refsys::Placement> series;
+               bool rotated = Refsys::placeCopies(drs, contEl, angle, series);
                drs.rotate(angle);
                for (int inst = 0; inst < ncopy; inst++)
                {
-                  double x = x0 + inst * dx;
-                  origin[0] = x;
-                  origin[1] = y + s;
-                  origin[2] = z;
-                  drs.shift(drs0, origin);
+                  drs.place(series[inst], rotated);
                   createVolume(targEl,drs);
                   drs.incrementIdentifiers();
                }
             }
          }
-         else if (comdS == "mposY")
+         else if (comd == kMposYTag)
          {
             XString ncopyS(contEl->getAttribute(X("ncopy")));
             int ncopy = atoi(S(ncopyS));
@@ -1844,17 +2355,12 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
 
             double y0, dy;
-            XString y0S(contEl->getAttribute(X("Y0")));
-            y0 = atof(S(y0S)) /unit.cm;
-            XString dyS(contEl->getAttribute(X("dY")));
-            dy = atof(S(dyS)) /unit.cm;
+            y0 = AttributeDecoder::value(contEl, "Y0") /unit.cm;
+            dy = AttributeDecoder::value(contEl, "dY") /unit.cm;
 
             double x, z, s;
-            XString zxS(contEl->getAttribute(X("Z_X")));
-            std::stringstream listr(zxS);
-            listr >> z >> x;
-            XString sS(contEl->getAttribute(X("S")));
-            s = atof(S(sS));
+            AttributeDecoder::get(contEl, "Z_X", z, x);
+            s = AttributeDecoder::value(contEl, "S");
             x /= unit.cm;
             z /= unit.cm;
             s /= unit.cm;
@@ -1868,23 +2374,18 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               containerS = el->getAttribute(X("container_name"));
-               containerTypeS = el->getAttribute(X("container_type"));
-               env = document->getElementById(X(containerS));
+               containerS = fContext.fTable[el].containerName;
+               containerTypeS = fContext.fTable[el].containerType;
+               env = loadElementById(document, containerS);
             }
             if (noRotation && (nSiblings == 1) && 
                 containerTypeS == "box")
             {
                double yMax, yMin;
-               XString envXYZS(env->getAttribute(X("X_Y_Z")));
-               if (envXYZS.size() > 0)
+               double hxyz[3];
+               if (AttributeDecoder::get(env, "X_Y_Z", hxyz, 3, "l") > 0)
                {
-                  std::stringstream xyzstr(envXYZS);
-                  double hx, hy, hz;
-                  xyzstr >> hx >> hy >> hz;
-                  Units munit;
-                  munit.getConversions(env);
-                  yMax = hy/2 /munit.cm;
+                  yMax = hxyz[1]/2;
                   yMin = -yMax;
                   // dyM = hy;  commented out to avoid compiler warnings 4/26/2015 DL
                }
@@ -1896,10 +2397,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                        << std::endl;
                   exit(1);
                }
-               static int yDivisions = 0xd00;
                std::stringstream divStr;
                divStr << "y" << std::setfill('0') << std::setw(3) << std::hex 
-                      << ++yDivisions;
+                      << ++fContext.fYDivisions;
                drs.fPartition.ncopy = ncopy;
                drs.fPartition.axis = "y";
                drs.fPartition.start = y0 - dy/2;
@@ -1907,9 +2407,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                drs.fPartition.step = dy;
                XString divS(divStr.str());
                createDivision(divS, drs);
-               drs.fMother = drs.fPartition.divEl;
-               targEl->setAttribute(X("container_name"),X(containerS));
-               targEl->setAttribute(X("container_type"),X(containerTypeS));
+               drs.fDivision = drs.fPartition.divName;
+               fContext.fTable[targEl].containerName = containerS;
+               fContext.fTable[targEl].containerType = containerTypeS;
                origin[0] = x + s;
                origin[1] = 0;
                origin[2] = z;
@@ -1920,22 +2420,18 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               Refsys drs0(drs);
+               std::vector<Refsys::Placement> series;
+               bool rotated = Refsys::placeCopies(drs, contEl, angle, series);
                drs.rotate(angle);
                for (int inst = 0; inst < ncopy; inst++)
                {
-                  double y = y0 + inst * dy;
-                  // double phi = atan2(y,x);
-                  origin[0] = x;
-                  origin[1] = y;
-                  origin[2] = z;
-                  drs.shift(drs0, origin);
+                  drs.place(series[inst], rotated);
                   createVolume(targEl,drs);
                   drs.incrementIdentifiers();
                }
             }
          }
-         else if (comdS == "mposZ")
+         else if (comd == kMposZTag)
          {
             XString ncopyS(contEl->getAttribute(X("ncopy")));
             int ncopy = atoi(S(ncopyS));
@@ -1949,30 +2445,19 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
 
             double z0, dz;
-            XString z0S(contEl->getAttribute(X("Z0")));
-            z0 = atof(S(z0S)) /unit.cm;
-            XString dzS(contEl->getAttribute(X("dZ")));
-            dz = atof(S(dzS)) /unit.cm;
+            z0 = AttributeDecoder::value(contEl, "Z0") /unit.cm;
+            dz = AttributeDecoder::value(contEl, "dZ") /unit.cm;
 
             double x, y, s;
-            XString xyS(contEl->getAttribute(X("X_Y")));
-            if (xyS.size() > 0)
-            {
-               std::stringstream listr(xyS);
-               listr >> x >> y;
-            }
-            else
+            if (AttributeDecoder::get(contEl, "X_Y", x, y) == 0)
             {
                double r, phi;
-               XString rphiS(contEl->getAttribute(X("R_Phi")));
-               std::stringstream listr(rphiS);
-               listr >> r >> phi;
+               AttributeDecoder::get(contEl, "R_Phi", r, phi);
                phi /= unit.rad;
                x = r * cos(phi);
                y = r * sin(phi);
             }
-            XString sS(contEl->getAttribute(X("S")));
-            s = atof(S(sS));
+            s = AttributeDecoder::value(contEl, "S");
             x /= unit.cm;
             y /= unit.cm;
             s /= unit.cm;
@@ -1986,9 +2471,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               containerS = el->getAttribute(X("container_name"));
-               containerTypeS = el->getAttribute(X("container_type"));
-               env = document->getElementById(X(containerS));
+               containerS = fContext.fTable[el].containerName;
+               containerTypeS = fContext.fTable[el].containerType;
+               env = loadElementById(document, containerS);
             }
             if (noRotation && (nSiblings == 1) &&
                 (containerTypeS == "tubs" ||
@@ -1999,51 +2484,33 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                 (containerS.size() != 0))
             {
                double zMax, zMin;
-               XString envXYZS(env->getAttribute(X("X_Y_Z")));
-               XString envRioZS(el->getAttribute(X("Rio_Z")));
-               XString envRxyZS(el->getAttribute(X("Rxy_Z")));
-               XString envXmpYmpZS(el->getAttribute(X("Xmp_Ymp_Z")));
-               if (envXYZS.size() > 0)
+               const Units& munit = Units::forElement(env);
+               double hxyz[3];
+               double riozv[3];
+               double rxyzv[3];
+               double xmpympzv[5];
+               if (AttributeDecoder::get(env, "X_Y_Z", hxyz, 3, "l") > 0)
                {
-                  std::stringstream xyzstr(envXYZS);
-                  double hx, hy, hz;
-                  xyzstr >> hx >> hy >> hz;
-                  Units munit;
-                  munit.getConversions(env);
-                  zMax = hz/2 /munit.cm;
+                  zMax = hxyz[2]/2;
                   zMin = -zMax;
                   // dzM = hz; commented out to avoid compiler warnings 4/26/2015 DL
                }
-               else if (envRioZS.size() > 0)
+               else if (AttributeDecoder::get(el, "Rio_Z", riozv, 3) > 0)
                {
-                  std::stringstream riozstr(envRioZS);
-                  double ri, ro, hz;
-                  riozstr >> ri >> ro >> hz;
-                  Units munit;
-                  munit.getConversions(env);
-                  zMax = hz/2 /munit.cm;
+                  zMax = riozv[2]/2 /munit.cm;
                   zMin = -zMax;
                   // dzM = hz; commented out to avoid compiler warnings 4/26/2015 DL
                }
-               else if (envRxyZS.size() > 0)
+               else if (AttributeDecoder::get(el, "Rxy_Z", rxyzv, 3) > 0)
                {
-                  std::stringstream xyzstr(envRxyZS);
-                  double rx, ry, hz;
-                  xyzstr >> rx >> ry >> hz;
-                  Units munit;
-                  munit.getConversions(env);
-                  zMax = hz/2 /munit.cm;
+                  zMax = rxyzv[2]/2 /munit.cm;
                   zMin = -zMax;
                   // dzM = hz; commented out to avoid compiler warnings 4/26/2015 DL
                }
-               else if (envXmpYmpZS.size() > 0)
+               else if (AttributeDecoder::get(el, "Xmp_Ymp_Z",
+                                              xmpympzv, 5) > 0)
                {
-                  std::stringstream xyzstr(envXmpYmpZS);
-                  double xm, xp, ym, yp, hz;
-                  xyzstr >> xm >> xp >> ym >> yp >> hz;
-                  Units munit;
-                  munit.getConversions(env);
-                  zMax = hz/2 /munit.cm;
+                  zMax = xmpympzv[4]/2 /munit.cm;
                   zMin = -zMax;
                   // dzM = hz;  commented out to avoid compiler warnings 4/26/2015 DL
                }
@@ -2055,10 +2522,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                        << std::endl;
                   exit(1);
                }
-               static int zDivisions = 0xd00;
                std::stringstream divStr;
                divStr << "z" << std::setfill('0') << std::setw(3) << std::hex
-                      << ++zDivisions;
+                      << ++fContext.fZDivisions;
                drs.fPartition.ncopy = ncopy;
                drs.fPartition.axis = "z";
                drs.fPartition.start = z0 - dz/2;
@@ -2066,9 +2532,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
                drs.fPartition.step = dz;
                XString divS(divStr.str());
                createDivision(divS, drs);
-               drs.fMother = drs.fPartition.divEl;
-               targEl->setAttribute(X("container_name"),X(containerS));
-               targEl->setAttribute(X("container_type"),X(containerTypeS));
+               drs.fDivision = drs.fPartition.divName;
+               fContext.fTable[targEl].containerName = containerS;
+               fContext.fTable[targEl].containerType = containerTypeS;
                double phi = atan2(y,x);
                origin[0] = x - s * sin(phi);
                origin[1] = y + s * cos(phi);
@@ -2080,22 +2546,18 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
             }
             else
             {
-               Refsys drs0(drs);
+               std::vector<Refsys::Placement> series;
+               bool rotated = Refsys::placeCopies(drs, contEl, angle, series);
                drs.rotate(angle);
-               double phi = atan2(y,x);
-               origin[0] = x - s * sin(phi);
-               origin[1] = y + s * cos(phi);
                for (int inst = 0; inst < ncopy; inst++)
                {
-                  double z = z0 + inst * dz;
-                  origin[2] = z;
-                  drs.shift(drs0, origin);
+                  drs.place(series[inst], rotated);
                   createVolume(targEl,drs);
                   drs.incrementIdentifiers();
                }
             }
          }
-         else if (comdS == "apply")
+         else if (comd == kApplyTag)
          {
             myRef.fRegionID = createRegion(contEl,drs);
             myRef.fIdentifier["map"] = drs.fIdentifier["map"];
@@ -2104,6 +2566,7 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
          }
          else
          {
+            XString comdS(contEl->getTagName());
             std::cerr
                  << APP_NAME << " error: composition of volume " << S(nameS)
                  << " contains unknown tag " << S(comdS) << std::endl;
@@ -2111,9 +2574,9 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
          }
       }
    }
-   else if (tagS == "stackX" || 
-            tagS == "stackY" ||
-            tagS == "stackZ")
+   else if (tag == kStackXTag || 
+            tag == kStackYTag ||
+            tag == kStackZTag)
    {
       std::cerr
            << APP_NAME << " error: stacks are not supported by " << APP_NAME
@@ -2123,30 +2586,25 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
    }
    else
    {
-      XString icopyS(el->getAttribute(X("HDDScopy")));
-      if (icopyS.size() != 0)
+      ElementTable::Entry& entry = fContext.fTable[el];
+      if (entry.copy >= 0)
       {
-         icopy = atoi(S(icopyS));
+         icopy = entry.copy;
       }
       else
       {
-         XString profS(el->getAttribute(X("profile")));
-         if (profS.size() != 0)
+         double prof[2];
+         if (AttributeDecoder::get(el, "profile", prof, 2, "d") != 0)
          {
-            double phi0, dphi;
-            std::stringstream listr(profS);
-            listr >> phi0 >> dphi;
-            Units punit;
-            punit.getConversions(el);
-            phi0 /= punit.deg;
-            dphi /= punit.deg;
+            double phi0 = prof[0];
+            double dphi = prof[1];
             if ( (myRef.fOrigin[0] == 0) && (myRef.fOrigin[1] == 0) )
             {
                phi0 -= myRef.fPhiOffset;
             }
-            std::stringstream pStr;
-            pStr << phi0 << " " << dphi;
-            el->setAttribute(X("profile"),X(pStr.str()));
+            entry.nprofile = 2;
+            entry.profile[0] = asWritten(phi0);
+            entry.profile[1] = asWritten(dphi);
          }
          createSolid(el,myRef);
          icopy = 0;
@@ -2160,29 +2618,74 @@ int CodeWriter::createVolume(DOMElement* el, Refsys& ref)
          ++icopy;
       }
 
-      std::stringstream icopyStr;
-      icopyStr << icopy;
-      el->setAttribute(X("HDDScopy"),X(icopyStr.str()));
-      XString voluS(el->getAttribute(X("HDDSvolu")));
-      int ivolu = atoi(S(voluS));
-      std::map<std::string,Refsys::VolIdent>::iterator iter;
+      entry.copy = icopy;
+      int ivolu = entry.volu;
+      std::map<std::string,Refsys::VolIdent>::const_iterator iter;
       for (iter = myRef.fIdentifier.begin();
            iter != myRef.fIdentifier.end();
            ++iter)
       {
          XString fieldS(iter->first);
-         std::vector<int>* idlist = &Refsys::fIdentifierTable[ivolu][fieldS];
+         std::vector<int>* idlist = &fContext.fIdentifierTable[ivolu][fieldS];
          while (idlist->size() < (unsigned int)icopy-1)
          {
             idlist->push_back(0);
          }
          idlist->push_back(iter->second.value);
       }
-      Refsys::fIdentifierTable[ivolu]["copy counter"].push_back(icopy);
+      fContext.fIdentifierTable[ivolu]["copy counter"].push_back(icopy);
    }
    return icopy;
 }
 
+CodeWriter::CodeWriter()
+ : fPending(false),
+   fNewRotation(false),
+   fOut(&std::cout)
+{
+}
+
+int CodeWriter::getProfile(DOMElement* el, double prof[2], const char* dims)
+{
+   const ElementTable::Entry* entry = fContext.fTable.find(el);
+   if (entry == 0 || entry->nprofile == 0)
+   {
+      return AttributeDecoder::get(el, "profile", prof, 2, dims);
+   }
+   prof[0] = entry->profile[0];
+   prof[1] = entry->profile[1];
+   if (dims != 0)
+   {
+      const Units& unit = Units::forElement(el);
+      prof[0] /= unit.deg;
+      prof[1] /= unit.deg;
+   }
+   return entry->nprofile;
+}
+
+int CodeWriter::getProfile(DOMElement* el, double& phi0, double& dphi)
+{
+   double prof[2];
+   int n = getProfile(el, prof);
+   phi0 = prof[0];
+   dphi = prof[1];
+   return n;
+}
+
+void CodeWriter::setOutput(std::ostream& out)
+{
+   fOut = &out;
+}
+
+void CodeWriter::addIdentifier(Refsys& ref, const XString& ident,
+                               int value, int step)
+{
+   ref.addIdentifier(ident, value, step);
+   Refsys::VolIdent& id = fContext.fIdentifiers[ident];
+   id.value = value;
+   id.step = step;
+}
+
 void CodeWriter::createHeader()
 {
 }
@@ -2217,6 +2720,8 @@ void CodeWriter::createUtilityFunctions(DOMElement* el, const XString& ident)
 
 void CodeWriter::translate(DOMElement* topel)
 {
+   fContext.clear();
+
    Refsys mrs;
    createHeader();
    createVolume(topel,mrs);
@@ -2228,16 +2733,18 @@ void CodeWriter::translate(DOMElement* topel)
    {
       DOMElement* propEl = (DOMElement*)propL->item(iprop);
       DOMElement* matEl = (DOMElement*)propEl->getParentNode();
-      XString imateS(matEl->getAttribute(X("HDDSmate")));
-      if (imateS.size() > 0)
+      const ElementTable::Entry* mate = fContext.fTable.find(matEl);
+      if (mate != 0 && mate->mate != 0)
       {
-         createSetFunctions(propEl,imateS);
+         std::stringstream imateStr;
+         imateStr << mate->mate;
+         createSetFunctions(propEl,XString(imateStr.str()));
       }
    }
 
    std::map<std::string,Refsys::VolIdent>::iterator iter;
-   for (iter = mrs.fIdentifiers.begin();
-        iter != mrs.fIdentifiers.end(); ++iter)
+   for (iter = fContext.fIdentifiers.begin();
+        iter != fContext.fIdentifiers.end(); ++iter)
    {
       createGetFunctions(topel, iter->first);
    }
@@ -2247,6 +2754,8 @@ void CodeWriter::translate(DOMElement* topel)
    createMapFunctions((DOMElement*)regionsL->item(0),XString("map"));
 
    createUtilityFunctions(topel,XString("user"));
+
+   fSubst = Substance();	// components point into the MaterialRegistry
 }
 
 void CodeWriter::dump(DOMElement* el, int level=0) // useful debug function
@@ -11,12 +11,196 @@
 
 #include <vector>
 #include <list>
+#include <deque>
 #include <map>
+#include <string>
+#include <iostream>
 #include "XString.hpp"
 #include <xercesc/dom/DOM.hpp>
 
 using namespace xercesc;
 
+enum HddsTag
+{
+ /* Tags that direct the construction of the volume hierarchy, so that
+  * the builders can dispatch on an integer instead of comparing strings.
+  * Any tag that is not in this list maps to kUnknownTag.
+  */
+   kUnknownTag = 0,
+   kCompositionTag,
+   kIntersectionTag,
+   kSubtractionTag,
+   kUnionTag,
+   kStackXTag,
+   kStackYTag,
+   kStackZTag,
+   kPosXYZTag,
+   kPosRPhiZTag,
+   kMposPhiTag,
+   kMposRTag,
+   kMposXTag,
+   kMposYTag,
+   kMposZTag,
+   kApplyTag
+};
+
+HddsTag hddsTag(const DOMElement* el);	// classify the tag name of el
+
+template <class K, class V>
+class SharedMap
+{
+ /* The SharedMap class is a std::map that copies of it share until one
+  * of them is changed (copy on write), so that copying an object that
+  * holds one costs a reference count instead of a tree.  Read access is
+  * through the const members.  operator[], clear() and modify() take a
+  * private copy of the map first if it is shared.  The reference count
+  * is not atomic, so all copies of one map should live in one thread.
+  */
+ public:
+   typedef std::map<K,V> Map;
+   typedef typename Map::iterator iterator;
+   typedef typename Map::const_iterator const_iterator;
+
+   SharedMap();
+   SharedMap(const SharedMap& src);
+   ~SharedMap();
+   SharedMap& operator=(const SharedMap& src);
+
+   const_iterator begin() const;
+   const_iterator end() const;
+   const_iterator find(const K& key) const;
+   bool empty() const;
+   int size() const;
+
+   V& operator[](const K& key);
+   void clear();
+   Map& modify();			// private copy, for writing
+
+ private:
+   struct Rep
+   {
+      Map map;
+      int refs;
+   };
+   Rep* fRep;				// 0 while the map is empty
+
+   const Map& get() const;
+   void release();
+};
+
+template <class K, class V>
+inline SharedMap<K,V>::SharedMap()
+ : fRep(0)
+{
+}
+
+template <class K, class V>
+inline SharedMap<K,V>::SharedMap(const SharedMap& src)
+ : fRep(src.fRep)
+{
+   if (fRep != 0)
+   {
+      ++fRep->refs;
+   }
+}
+
+template <class K, class V>
+inline SharedMap<K,V>::~SharedMap()
+{
+   release();
+}
+
+template <class K, class V>
+inline SharedMap<K,V>& SharedMap<K,V>::operator=(const SharedMap& src)
+{
+   if (src.fRep != 0)
+   {
+      ++src.fRep->refs;
+   }
+   release();
+   fRep = src.fRep;
+   return *this;
+}
+
+template <class K, class V>
+inline const std::map<K,V>& SharedMap<K,V>::get() const
+{
+   static const Map emptyMap;
+   return (fRep != 0)? fRep->map : emptyMap;
+}
+
+template <class K, class V>
+inline typename SharedMap<K,V>::const_iterator SharedMap<K,V>::begin() const
+{
+   return get().begin();
+}
+
+template <class K, class V>
+inline typename SharedMap<K,V>::const_iterator SharedMap<K,V>::end() const
+{
+   return get().end();
+}
+
+template <class K, class V>
+inline typename SharedMap<K,V>::const_iterator
+SharedMap<K,V>::find(const K& key) const
+{
+   return get().find(key);
+}
+
+template <class K, class V>
+inline bool SharedMap<K,V>::empty() const
+{
+   return get().empty();
+}
+
+template <class K, class V>
+inline int SharedMap<K,V>::size() const
+{
+   return get().size();
+}
+
+template <class K, class V>
+inline V& SharedMap<K,V>::operator[](const K& key)
+{
+   return modify()[key];
+}
+
+template <class K, class V>
+inline void SharedMap<K,V>::clear()
+{
+   release();
+}
+
+template <class K, class V>
+std::map<K,V>& SharedMap<K,V>::modify()
+{
+   if (fRep == 0)
+   {
+      fRep = new Rep;
+      fRep->refs = 1;
+   }
+   else if (fRep->refs > 1)
+   {
+      Rep* rep = new Rep;
+      rep->map = fRep->map;
+      rep->refs = 1;
+      --fRep->refs;
+      fRep = rep;
+   }
+   return fRep->map;
+}
+
+template <class K, class V>
+inline void SharedMap<K,V>::release()
+{
+   if (fRep != 0 && --fRep->refs == 0)
+   {
+      delete fRep;
+   }
+   fRep = 0;
+}
+
 class Refsys
 {
  /* The Refsys class is used to propagate coordinate system information
@@ -76,9 +260,21 @@ class Refsys
   * rotate() and shift() methods, but are not reset by the reset() method.
   * The master reference system (MRS) coincides with the local coordinate
   * system of the root volume in the geometry tree.
+  *
+  * Refsys objects are copied at every step of the placement, so the
+  * identifier list and the parameter table are kept in SharedMaps that
+  * are only copied when a copy of the Refsys changes them, and the names
+  * of divisions and axes are pointers to strings that are not copied.  The copies
+  * of a multiple placement (mposPhi, mposR, mposX, ...) can be computed
+  * together with placeSeries() and then loaded one at a time with
+  * place(), instead of building a temporary Refsys for every copy.
+  * placeCopies() does this for the copies of an mposXXX tag, so that
+  * CodeWriter and GeometryModel expand them by the same rules.
   */
  public:
    DOMElement* fMother;        	// current mother volume element
+   const std::string* fDivision; // division of fMother that is the actual
+				// mother, 0 if none
    DOMElement* fRegion;        	// associated region, 0 if default
    double fPhiOffset;        	// azimuthal angle of volume origin (deg)
    double fOrigin[3];        	// x,y,z coordinate of volume origin (cm)
@@ -96,17 +292,15 @@ class Refsys
       int value;
       int step;
    };
-   std::map<std::string,VolIdent> fIdentifier;          // identifier list 
-   static std::map<std::string,VolIdent> fIdentifiers;  // master id list 
-
-   static std::vector<std::map<std::string,std::vector<int> > >
-          fIdentifierTable;			    // identifier lookup maps
+   typedef SharedMap<std::string,VolIdent> IdentifierMap;
+   IdentifierMap fIdentifier;                           // identifier list 
 
    struct Partition
    {
-      DOMElement* divEl;
+      const std::string* divName;	// name given by createDivision(),
+					// kept in the TranslationContext
       int ncopy;
-      std::string axis;
+      const char* axis;			// "x", "y", "z", "rho" or "phi"
       double offset;
       double start;
       double step;
@@ -127,8 +321,37 @@ class Refsys
    Refsys& rotate(const Refsys& ref,
                   const double omega[3]); // rotate by omega in ref frame
 
-   std::vector<double>& getRotation() const; // get rotation vector omega (rad)
-   std::vector<double>& getMRotation() const; // get MRS rotation vector (rad)
+   struct EulerAngles
+   {
+      double omega[3];			// omega_x, omega_y, omega_z (rad)
+      double& operator[](int i) { return omega[i]; }
+      double operator[](int i) const { return omega[i]; }
+   };
+   XString getMotherName() const;	// name of fDivision or fMother
+   EulerAngles getRotation() const;	// get rotation vector omega (rad)
+   EulerAngles getMRotation() const;	// get MRS rotation vector (rad)
+
+   struct Placement
+   {
+      double origin[3];			// fOrigin of this copy
+      double morigin[3];		// fMOrigin of this copy
+      double rmatrix[3][3];		// fRmatrix of this copy
+      double mrmatrix[3][3];		// fMRmatrix of this copy
+      int rotation;			// fRotation of this copy
+   };
+   static void placeSeries(const Refsys& ref,	// compute one placement
+                           const std::vector<double>& vectors, // per shift
+                           const std::vector<double>& omegas, // vectors[3*i..]
+                           std::vector<Placement>& series); // and rotation
+						// omegas[3*i..] in the frame
+						// of ref, none if no omegas
+   static bool placeCopies(const Refsys& ref, // placeSeries for the
+                           DOMElement* mposEl, // copies of an mposXXX tag
+                           const double omega[3], // rotated by omega,
+                           std::vector<Placement>& series); // true if
+						// each copy has its own rotation
+   Refsys& place(const Placement& copy,	// load one copy of a series,
+                 bool rotated);		// with its rotation if rotated
 
    void addIdentifier(XString ident,
                       int value,
@@ -136,15 +359,48 @@ class Refsys
    void incrementIdentifiers(); // increments all identifiers by one step
    void clearIdentifiers();	// resets the current identifier list
 
-   int nextRotationID();	// generate unique rotation index sequence
-   int nextRegionID();		// generate unique region index sequence
-   int nextVolumeID();		// generate unique volume index sequence
+   SharedMap<std::string,double> fPar; // key-value table for user needs
+};
+
+class RotationRegistry
+{
+ /* The RotationRegistry class keeps one entry per distinct rotation matrix
+  * that has been given a rotation index, so that all placements with the
+  * same rotation share one rotation definition in the generated code.
+  * Before a matrix is looked up, elements that lie within fSnapTolerance
+  * of 0 or +/-1 are set to that value exactly, so the 90 and 180 degree
+  * rotations built up from sums of angles come out identical.  Matrices
+  * then match if every element agrees to within fMatchTolerance.  The
+  * entries are ordered by a weighted sum of the elements, with weights
+  * 3^0 .. 3^8 so that the matrices made of 0 and +/-1 all have distinct
+  * keys, and find() compares only the entries whose key lies within
+  * fKeyTolerance of that of the matrix.  Any two matrices that match
+  * have keys that close, so a match is never missed.  Each translation
+  * has its own registry in its TranslationContext.
+  */
+ public:
+   static void snap(double Rmatrix[3][3]);	// round to exact 0, +/-1
+   static bool isIdentity(const double Rmatrix[3][3]);
+   int find(const double Rmatrix[3][3]) const;	// rotation index, or 0
+   void insert(const double Rmatrix[3][3],
+               int irot);			// register a new rotation
+   int size() const;				// distinct rotations so far
+   void clear();
 
-   std::map<std::string,double> fPar; // key-value table for user needs
+   static const double fSnapTolerance;
+   static const double fMatchTolerance;
+   static const double fKeyTolerance;
 
-   static int fRotations;	// non-trivial rotations defined so far
-   static int fRegions;        	// total number of regions so far
-   static int fVolumes;        	// total number of volumes so far
+ private:
+   struct Entry
+   {
+      double rmatrix[3][3];
+      int irot;
+   };
+
+   static double key(const double Rmatrix[3][3]);
+
+   std::multimap<double,Entry> fEntries;
 };
 
 class Units
@@ -157,6 +413,10 @@ class Units
   * where unit is a Units class instance that has been previously set.
   * The user of the Units class should generally treat its data members
   * as constants and use Units::getConversions() to manage the values. 
+  * The unit names are looked up in a table that is built once, and the
+  * result for each combination of unit attributes is remembered, so
+  * Units::forElement() can hand back the units of an element from a
+  * per-element cache without reading its attributes again.
   */
  public:
    double s,ns,ms;
@@ -177,7 +437,30 @@ class Units
    Units(const Units& u);		// copy constructor
    void getConversions(DOMElement* el);	// get conversion constants from tag
 
+   static const Units& forElement(DOMElement* el); // same as getConversions
+						   // on new Units, cached
+   static void clearCache();		// forget the per-element units,
+					// call after releasing a document
+
  private:
+   struct Scale
+   {
+      double length;			// document units per cm, 0 if unset
+      double angle;			// per rad (or deg), 0 if unset
+      bool angleInDeg;			// angle is given per deg
+      double energy;			// per MeV, 0 if unset
+      double mass;			// per g, 0 if unset
+      double area;			// per cm^2, 0 if unset
+      double volume;			// per cm^3, 0 if unset
+      double field;			// per Gauss, 0 if unset
+   };
+
+   static const Scale& resolve(DOMElement* el);
+   void apply(const Scale& scale);
+
+   static std::map<std::string,Scale> fScales;
+   static std::map<const DOMElement*,Units> fElementUnits;
+
    void set_1s(double tu);
    void set_1cm(double lu);
    void set_1rad(double au);
@@ -191,28 +474,110 @@ class Units
    void set_1G(double bfu);
 };
 
+class AttributeDecoder
+{
+ /* The AttributeDecoder class turns the numeric attributes of hdds
+  * elements (X_Y_Z, Rio_Z, R_Phi_Z, profile, rot, ...) into lists of
+  * doubles.  Each attribute is decoded only once per element.  The
+  * result is kept in a side table keyed by element, so that later
+  * visits from the same or another code writer cost a single lookup.
+  * The number parser does not depend on the C locale.  Values come
+  * back in the units in which they are written, unless a dims string is
+  * given.  A dims string holds one letter per value:
+  *	'l' : length, converted to cm
+  *	'a' : angle, converted to rad
+  *	'd' : angle, converted to deg
+  *	'-' : no conversion
+  * The units are taken from the element that carries the attribute, and
+  * the last letter applies to any values beyond the end of dims.  An
+  * attribute that is changed after it has been decoded must be dropped
+  * from the table with forget().
+  */
+ public:
+   static const std::vector<double>& values(DOMElement* el,
+                                            const char* attr,
+                                            const char* dims = 0);
+   static int get(DOMElement* el, const char* attr,
+                  double* v, int n,	// copy up to n values into v,
+                  const char* dims = 0);// pad with 0, return # decoded
+   static int get(DOMElement* el, const char* attr, double& v0);
+   static int get(DOMElement* el, const char* attr, double& v0,
+                  double& v1);
+   static int get(DOMElement* el, const char* attr, double& v0,
+                  double& v1, double& v2);
+   static int get(DOMElement* el, const char* attr, double& v0,
+                  double& v1, double& v2, double& v3, double& v4);
+   static double value(DOMElement* el,	// first value, or 0 if absent
+                       const char* attr, const char* dims = 0);
+
+   static double parseDouble(const char* str,  // locale-free strtod
+                             const char** end);
+   static void forget(DOMElement* el,	// drop the cached values of
+                      const char* attr);	// an attribute that changed
+   static void clear();			// forget all cached values,
+					// call after releasing a
+					// document
+ private:
+   typedef std::pair<const DOMElement*,std::string> Key;
+   static std::map<Key,std::vector<double> > fCache;
+};
+
+inline int AttributeDecoder::get(DOMElement* el, const char* attr,
+                                 double& v0)
+{
+   return get(el, attr, &v0, 1);
+}
+
+inline int AttributeDecoder::get(DOMElement* el, const char* attr,
+                                 double& v0, double& v1)
+{
+   double v[2];
+   int n = get(el, attr, v, 2);
+   v0 = v[0], v1 = v[1];
+   return n;
+}
+
+inline int AttributeDecoder::get(DOMElement* el, const char* attr,
+                                 double& v0, double& v1, double& v2)
+{
+   double v[3];
+   int n = get(el, attr, v, 3);
+   v0 = v[0], v1 = v[1], v2 = v[2];
+   return n;
+}
+
+inline int AttributeDecoder::get(DOMElement* el, const char* attr,
+                                 double& v0, double& v1, double& v2,
+                                 double& v3, double& v4)
+{
+   double v[5];
+   int n = get(el, attr, v, 5);
+   v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3], v4 = v[4];
+   return n;
+}
+
 class Substance
 {
  /* The Substance class is used to collect and manage materials
-  * property information for the simulation components.
+  * property information for the simulation components.  The components
+  * in fBrewList are the shared instances held by MaterialRegistry, so
+  * copying a Substance copies only its own properties and the list of
+  * pointers to its components.
   */
  public:
    Substance();
    Substance(DOMElement* elem);
-   Substance(const Substance& src);
-   Substance &operator=(const Substance& src);
-   ~Substance();
-
-   XString getName();		// return name of material
-   XString getSymbol();		// return chem. symbol (if any)
-   double getAtomicWeight();	// return A for a material
-   double getAtomicNumber();	// return Z for a material
-   double getDensity();		// return density [g/cm^3]
-   double getRadLength();	// return radiation len. [cm]
-   double getAbsLength();	// return nucl.abs.len. [cm]
-   double getColLength();	// return nucl.col.len. [cm]
-   double getMIdEdx();		// return min. dE/dx [MeV/g/cm^3]
-   DOMElement* getDOMElement();	// return DOM element ptr
+
+   XString getName() const;	// return name of material
+   XString getSymbol() const;	// return chem. symbol (if any)
+   double getAtomicWeight() const; // return A for a material
+   double getAtomicNumber() const; // return Z for a material
+   double getDensity() const;	// return density [g/cm^3]
+   double getRadLength() const;	// return radiation len. [cm]
+   double getAbsLength() const;	// return nucl.abs.len. [cm]
+   double getColLength() const;	// return nucl.col.len. [cm]
+   double getMIdEdx() const;	// return min. dE/dx [MeV/g/cm^3]
+   DOMElement* getDOMElement() const; // return DOM element ptr
 
    int fUniqueID;		// user-assignable index
    class Brew
@@ -220,7 +585,8 @@ class Substance
     public:
       int natoms;		// number of atoms in chemical formula
       double wfact;		// fraction by weight in mixture
-      Substance* sub;		// ptr to material description of component
+      Substance* sub;		// ptr to material description of component,
+				// owned by MaterialRegistry
    };
    std::list<Brew> fBrewList;
 
@@ -235,6 +601,120 @@ class Substance
    double fMIdEdx;
 };
 
+class MaterialRegistry
+{
+ /* The MaterialRegistry class holds one Substance for each material
+  * element that has been asked for, built the first time it is needed
+  * together with the components it is mixed from.  A composite that is
+  * used by many others is then only evaluated once, and its derived
+  * properties are shared by all of them.  The properties must not be
+  * changed once the Substance is in the registry, and that includes the
+  * user index fUniqueID: a code writer numbers its materials in its own
+  * TranslationContext and sets the index only on its own copy.  Entries
+  * refer to elements of the document, so clear() must be called after
+  * the document is released, once no copy of a Substance that points
+  * to its components is left.
+  */
+ public:
+   static Substance& get(DOMElement* el);	// build el once, then share
+   static void clear();				// forget all materials
+
+ private:
+   static std::map<const DOMElement*,Substance*> fSubstances;
+};
+
+class ElementTable
+{
+ /* The ElementTable class holds the bookkeeping that a CodeWriter keeps
+  * about the elements of the document during a translation: the volume,
+  * copy and material indices, the volume that an envelope was given to,
+  * the container of a volume that is placed in a division, the profile
+  * of a solid with the phi offset of its mother applied, and the places
+  * where each region is applied.  An element gets an ordinal the first
+  * time it is looked up and its entry is kept at that ordinal, so the
+  * document is never modified and can be translated more than once.
+  * Entries do not move, so a reference to one stays valid while more
+  * entries are added.
+  */
+ public:
+   struct RegionMap
+   {
+      int id;				// region index
+      double origin[3];			// origin in the MRS (cm)
+      double Rmatrix[3][3];		// rotation matrix (region -> MRS)
+   };
+
+   struct Entry
+   {
+      Entry();
+      int volu;				// volume index, 0 if none yet
+      int copy;				// copies placed, -1 if no volume
+      int mate;				// material index, 0 if none yet
+      int region;			// region index of an apply tag
+      std::string contains;		// volume placed in this envelope
+      std::string containerName;	// container of a volume that is
+      std::string containerType;	// placed in a division of it
+      int nprofile;			// number of values in profile
+      double profile[2];		// profile after the phi offset
+      std::vector<RegionMap> maps;	// applications of this region
+   };
+
+   Entry& operator[](const DOMElement* el);	// add entry on first use
+   const Entry* find(const DOMElement* el) const; // 0 if never added
+   int ordinal(const DOMElement* el) const;	// -1 if never added
+   int size() const;
+   void clear();
+
+ private:
+   std::map<const DOMElement*,int> fOrdinal;
+   std::deque<Entry> fEntries;
+};
+
+class TranslationContext
+{
+ /* The TranslationContext class holds everything that one translation
+  * hands out or accumulates as it walks the tree: the index counters for
+  * volumes, regions, rotations, materials, media and divisions, the
+  * registry of distinct rotations, the identifier tables, the names of
+  * the divisions and the state kept per element.  Every CodeWriter owns
+  * one, and translate() clears it before it starts, so one process can
+  * translate any number of geometries.  What stays process-wide are the caches of values that
+  * are derived from the parsed documents alone (Units, AttributeDecoder
+  * and MaterialRegistry); they remain valid from one translation of a
+  * document to the next, and a tool that releases a document empties
+  * each of them with its own clear.
+  */
+ public:
+   TranslationContext();
+   void clear();
+
+   int nextRotationID();	// generate unique rotation index sequence
+   int nextRegionID();		// generate unique region index sequence
+   int nextVolumeID();		// generate unique volume index sequence
+
+   int fRotations;		// non-trivial rotations defined so far
+   int fRegions;		// total number of regions so far
+   int fVolumes;		// total number of volumes so far
+   int fMaterialCount;		// materials defined so far
+   int fMediumCount;		// tracking media defined so far
+   int fPhiDivisions;		// last phi division index (from 0xd00)
+   int fRDivisions;		// last radial division index (from 0xd00)
+   int fXDivisions;		// last x division index (from 0xd00)
+   int fYDivisions;		// last y division index (from 0xd00)
+   int fZDivisions;		// last z division index (from 0xd00)
+
+   std::map<std::string,Refsys::VolIdent> fIdentifiers;  // master id list 
+   std::vector<std::map<std::string,std::vector<int> > >
+          fIdentifierTable;			    // identifier lookup maps
+   RotationRegistry fRotationTable;	// distinct rotations defined so far
+   ElementTable fTable;			// per-element state
+   std::deque<std::string> fDivisionNames; // names of divisions so far
+
+ private:
+   TranslationContext(const TranslationContext&);
+   void operator=(const TranslationContext&);
+};
+
 class CodeWriter
 {
  /* The CodeWriter class provides basic functionality for instantiating
@@ -246,10 +726,16 @@ class CodeWriter
   * invoke the corresponding methods of the base class in order to
   * obtain the correct geometry construction, or else they need to 
   * incorporate equivalent functionality themselves.
+  *
+  * The indices and other state of the walk are kept in fContext, which
+  * translate() clears before it starts.  The generated code goes to
+  * std::cout unless setOutput() names another stream, normally the
+  * stream of an OutputSink.
   */
  public:
-   CodeWriter() {};
+   CodeWriter();
    void translate(DOMElement* el);		// invokes the code writer
+   void setOutput(std::ostream& out);		// stream for generated code
    virtual void createHeader();
    virtual void createTrailer();
    virtual int createMaterial(DOMElement* el);	// generate code for materials
@@ -273,10 +759,23 @@ class CodeWriter
 
  protected:
    bool fPending;       // indicates a volume positioning request is pending
-   Substance fSubst;    // work area for latest material definition
+   Substance fSubst;    // work area for latest material definition,
+			// emptied again at the end of translate()
    Refsys fRef;		// work area for latest reference system
+   bool fNewRotation;   // last createRotation() defined a new index
+   TranslationContext fContext; // indices and tables of the translation
+   std::ostream* fOut;  // destination of the generated code
+
+   int getProfile(DOMElement* el, double prof[2], // profile of a solid,
+                  const char* dims = 0);	// as placed in its mother
+   int getProfile(DOMElement* el, double& phi0, double& dphi);
+   void addIdentifier(Refsys& ref,		// add to ref and to the
+                      const XString& ident,	// master list
+                      int value, int step);
 
  private:
+   CodeWriter(const CodeWriter&);
+   void operator=(const CodeWriter&);
    void dump(DOMElement* el, int level);  // useful for debugging, keep me!
 };
 
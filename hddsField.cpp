@@ -0,0 +1,769 @@
+/*  HDDS Field Engine
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Implementation Notes:
+ *  ---------------------
+ * 1. The regions are collected by a CodeWriter that writes no code.  The
+ *    numbering of the applications of the regions, and the origin and
+ *    rotation of each, are a by-product of the placement walk, so running
+ *    the walk is the only way to be sure that region n here is region n
+ *    in the generated gufld routine as well.
+ * 2. The transformations and the handling of the grids follow the code
+ *    that the FortranWriter generates: the point is moved into the region
+ *    frame, the grids of a map are tried in the order they are declared,
+ *    the first one that contains the point is used, and the field of a
+ *    point outside of all of them is zero.  Only the interpolation itself
+ *    differs: the generated interpol3 extrapolates from the nearest site
+ *    along the local gradients, this engine interpolates trilinearly
+ *    between the eight sites of the cell, which is continuous across the
+ *    cell boundaries.
+ * 3. The interpolation works on the corners of the cell as vectors of
+ *    four floats, so that the seven linear blends that make up a trilinear
+ *    interpolation each handle all three components at once.  With SSE
+ *    available each blend is a couple of vector instructions.
+ * 4. A point on the far side of a mirror plane is reflected into the grid
+ *    before the lookup, and the components of the field that comes back
+ *    are flipped as the mirror declares.  An axisymmetric grid needs the
+ *    azimuth of the point only to turn B_r into B_x and B_y, which x/rho
+ *    and y/rho do without the trigonometric calls.
+ */
+
+#include "XString.hpp"
+#include "hddsCommon.hpp"
+#include "hddsField.hpp"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include <iostream>
+#include <sstream>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#define APP_NAME "hddsField"
+
+#define X(str) XName(str)
+#define S(str) str.c_str()
+
+static const double twopi = 6.28318530717959;
+
+#ifdef __SSE__
+static inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+{
+   return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+#endif
+
+bool FieldGrid::read(DOMElement* mapfEl,
+                     std::vector<FieldGrid>& grids,
+                     std::string& error)
+{
+   grids.clear();
+   DOMElement* regionEl = (DOMElement*)mapfEl->getParentNode();
+   XString nameS(regionEl->getAttribute(X("name")));
+   std::stringstream msg;
+
+   DOMNodeList* gridL = mapfEl->getElementsByTagName(X("grid"));
+   for (unsigned int igrid = 0; igrid < gridL->getLength(); ++igrid)
+   {
+      DOMElement* gridEl = (DOMElement*)gridL->item(igrid);
+      XString typeS(gridEl->getAttribute(X("type")));
+      FieldGrid grid;
+      grid.type = (typeS == "cylindrical")? kCylindrical :
+                  (typeS == "axisymmetric")? kAxisymmetric : kCartesian;
+      if (grids.size() > 0 && grid.type != grids[0].type)
+      {
+         msg << "mappedBfield in region " << S(nameS)
+             << " superimposes incompatible grid types.";
+         error = msg.str();
+         return false;
+      }
+
+      int levels = (grid.type == kAxisymmetric)? 2 : 3;
+      DOMNodeList* samplesL = gridEl->getElementsByTagName(X("samples"));
+      if ((int)samplesL->getLength() != levels)
+      {
+         msg << "mappedBfield in region " << S(nameS)
+             << ((levels == 2)? " does not have samples for the r and z axes."
+                              : " does not have samples for three axes.");
+         error = msg.str();
+         return false;
+      }
+
+      const char* axes[3] = {"x", "y", "z"};
+      if (grid.type != kCartesian)
+      {
+         axes[0] = "r";
+         axes[1] = (grid.type == kCylindrical)? "phi" : 0;
+      }
+      for (int i = 0; i < 3; ++i)
+      {
+         grid.nsites[i] = 0;
+         grid.lower[i] = grid.upper[i] = 0;
+         grid.sense[i] = 1;
+         grid.mirror[i][0] = grid.mirror[i][1] = grid.mirror[i][2] = 0;
+      }
+      for (int level = 0; level < levels; ++level)
+      {
+         DOMElement* sampleEl = (DOMElement*)samplesL->item(level);
+         XString axisS(sampleEl->getAttribute(X("axis")));
+         XString nS(sampleEl->getAttribute(X("n")));
+         XString senseS(sampleEl->getAttribute(X("sense")));
+         int iaxis;
+         for (iaxis = 0; iaxis < 3; ++iaxis)
+         {
+            if (axes[iaxis] != 0 && axisS == axes[iaxis])
+            {
+               break;
+            }
+         }
+         int n = atoi(S(nS));
+         if (iaxis == 3 || grid.nsites[iaxis] != 0 || n < 1)
+         {
+            msg << "grid in region " << S(nameS)
+                << " contains an incompatible set of samples.";
+            error = msg.str();
+            return false;
+         }
+
+         double bound[2];
+         const Units& sunit = Units::forElement(sampleEl);
+         AttributeDecoder::get(sampleEl, "bounds", bound, 2);
+         double scale = (grid.type == kCylindrical && iaxis == 1)?
+                        sunit.rad : sunit.cm;
+         grid.axis[level] = iaxis;
+         grid.nsites[iaxis] = n;
+         grid.lower[iaxis] = bound[0] / scale;
+         grid.upper[iaxis] = bound[1] / scale;
+         grid.sense[iaxis] = (senseS == "reverse")? -1 : 1;
+
+         double sign[3];
+         if (AttributeDecoder::get(sampleEl, "mirror", sign, 3) > 0)
+         {
+            bool valid = (grid.type == kCartesian || iaxis == 2);
+            for (int i = 0; i < 3; ++i)
+            {
+               valid = valid && (sign[i] == 1 || sign[i] == -1);
+               grid.mirror[iaxis][i] = (sign[i] < 0)? -1 : 1;
+            }
+            if (! valid)
+            {
+               msg << "grid in region " << S(nameS)
+                   << " declares an invalid mirror on the "
+                   << S(axisS) << " axis.";
+               error = msg.str();
+               return false;
+            }
+         }
+      }
+      if (grid.type == kAxisymmetric)
+      {
+         grid.nsites[1] = 1;		// phi, nested inside r and z
+         grid.axis[2] = 1;
+      }
+
+      if (grids.size() > 0)
+      {
+         for (int i = 0; i < 3; ++i)
+         {
+            if (grid.nsites[i] != grids[0].nsites[i] ||
+                grid.axis[i] != grids[0].axis[i])
+            {
+               msg << "mappedBfield in region " << S(nameS)
+                   << " combines incompatible grid elements.";
+               error = msg.str();
+               return false;
+            }
+         }
+      }
+      grids.push_back(grid);
+   }
+
+   if (grids.size() == 0)
+   {
+      msg << "mappedBfield in region " << S(nameS)
+          << " does not contain a grid.";
+      error = msg.str();
+      return false;
+   }
+   return true;
+}
+
+bool FieldGrid::readText(const std::string& path,
+                         std::vector<float>& values,
+                         std::string& error) const
+{
+   std::stringstream msg;
+   FILE* text = fopen(path.c_str(), "r");
+   if (text == 0)
+   {
+      msg << "cannot open field map " << path;
+      error = msg.str();
+      return false;
+   }
+
+   size_t nsite = (size_t)nsites[0] * nsites[1] * nsites[2];
+   values.resize(nsite * 3);
+   size_t stride[3] = {1, (size_t)nsites[0], (size_t)nsites[0] * nsites[1]};
+   size_t count = 0;
+   int index[3];
+   for (index[0] = 0; index[0] < nsites[axis[0]]; ++index[0])
+   {
+      for (index[1] = 0; index[1] < nsites[axis[1]]; ++index[1])
+      {
+         for (index[2] = 0; index[2] < nsites[axis[2]]; ++index[2])
+         {
+            size_t site = index[0] * stride[axis[0]] +
+                          index[1] * stride[axis[1]] +
+                          index[2] * stride[axis[2]];
+            float* v = &values[site * 3];
+            if (fscanf(text, "%f %f %f", &v[0], &v[1], &v[2]) != 3)
+            {
+               fclose(text);
+               msg << "field map " << path << " ends after "
+                   << count << " of " << nsite << " sites";
+               error = msg.str();
+               return false;
+            }
+            ++count;
+         }
+      }
+   }
+   fclose(text);
+   return true;
+}
+
+class FieldCollector : public CodeWriter
+{
+ /* Walks the geometry as a translator would, without writing any code,
+  * and passes the applications of the regions on to a FieldEngine.
+  */
+ public:
+   FieldCollector(FieldEngine& engine);
+
+   bool isOk() const;
+   void createMapFunctions(DOMElement* el, const XString& ident);
+
+ private:
+   FieldEngine& fEngine;
+   bool fOk;
+
+   int addMap(DOMElement* mapfEl);
+};
+
+FieldCollector::FieldCollector(FieldEngine& engine)
+ : fEngine(engine),
+   fOk(true)
+{
+}
+
+bool FieldCollector::isOk() const
+{
+   return fOk;
+}
+
+int FieldCollector::addMap(DOMElement* mapfEl)
+{
+   DOMElement* regionEl = (DOMElement*)mapfEl->getParentNode();
+   XString nameS(regionEl->getAttribute(X("name")));
+   XString mapS(mapfEl->getAttribute(X("map")));
+   XString encS(mapfEl->getAttribute(X("encoding")));
+
+   std::vector<FieldGrid> layouts;
+   std::string error;
+   if (! FieldGrid::read(mapfEl, layouts, error))
+   {
+      std::cerr << APP_NAME << " error: " << error << std::endl;
+      return -1;
+   }
+   else if (mapS.substr(0,7) != "file://")
+   {
+      std::cerr
+           << APP_NAME << " error: mappedBfield in region " << S(nameS)
+           << " uses unsupported map URL " << mapS << std::endl;
+      return -1;
+   }
+   mapS.erase(0,7);
+
+   FieldEngine::Map* map = new FieldEngine::Map();
+   for (int i = 0; i < 3; ++i)
+   {
+      map->nsites[i] = layouts[0].nsites[i];
+   }
+   bool ok;
+   const int* sites = map->nsites;
+   if (encS == "bricked")
+   {
+      map->bricked = new BrickedFieldMap();
+      ok = map->bricked->open(mapS);
+      sites = map->bricked->getSites();
+   }
+   else if (encS == "octree")
+   {
+      map->octree = new OctreeFieldMap();
+      ok = map->octree->open(mapS);
+      sites = map->octree->getSites();
+   }
+   else if (encS == "utf-8")
+   {
+      ok = layouts[0].readText(mapS, map->values, error);
+      if (! ok)
+      {
+         std::cerr << APP_NAME << " error: " << error << std::endl;
+      }
+   }
+   else
+   {
+      std::cerr
+           << APP_NAME << " error: mappedBfield in region " << S(nameS)
+           << " uses unsupported encoding " << encS << std::endl;
+      ok = false;
+   }
+   if (ok && (sites[0] != map->nsites[0] || sites[1] != map->nsites[1] ||
+              sites[2] != map->nsites[2]))
+   {
+      std::cerr
+           << APP_NAME << " error: field map " << mapS
+           << " does not match the grid of region " << S(nameS)
+           << std::endl;
+      ok = false;
+   }
+   if (! ok)
+   {
+      delete map;
+      return -1;
+   }
+
+   for (unsigned int igrid = 0; igrid < layouts.size(); ++igrid)
+   {
+      FieldEngine::Grid grid;
+      grid.layout = layouts[igrid];
+      for (int i = 0; i < 3; ++i)
+      {
+         grid.invSpan[i] = 1 / (grid.layout.upper[i] - grid.layout.lower[i]);
+         grid.cells[i] = grid.layout.nsites[i] - 1;
+      }
+      if (grid.layout.type == FieldGrid::kAxisymmetric)
+      {
+         grid.invSpan[1] = 0;		// no phi axis
+      }
+      grid.alpha = fabs(twopi * grid.invSpan[1]);
+      map->grids.push_back(grid);
+   }
+   fEngine.fMaps.push_back(map);
+   return fEngine.fMaps.size() - 1;
+}
+
+void FieldCollector::createMapFunctions(DOMElement* el, const XString& ident)
+{
+   CodeWriter::createMapFunctions(el,ident);
+
+   if (el == 0)
+   {
+      return;
+   }
+   DOMNodeList* regionL = el->getElementsByTagName(X("region"));
+   for (unsigned int ireg=0; ireg < regionL->getLength(); ++ireg)
+   {
+      DOMElement* regionEl = (DOMElement*)regionL->item(ireg);
+      const std::vector<ElementTable::RegionMap>& maps =
+            fContext.fTable[regionEl].maps;
+      if (maps.size() == 0)
+      {
+         continue;
+      }
+
+      FieldEngine::Region reg;
+      reg.name = XString(regionEl->getAttribute(X("name")));
+      DOMNodeList* unifTagL = regionEl->getElementsByTagName(X("uniformBfield"));
+      DOMNodeList* compTagL = regionEl->getElementsByTagName(X("computedBfield"));
+      DOMNodeList* mapfTagL = regionEl->getElementsByTagName(X("mappedBfield"));
+      double b[3] = {0, 0, 0};
+      if (unifTagL->getLength() > 0)
+      {
+         DOMElement* unifEl = (DOMElement*)unifTagL->item(0);
+         AttributeDecoder::get(unifEl, "Bx_By_Bz", b, 3);
+         const Units& unit = Units::forElement(unifEl);
+         b[0] /= unit.kG;
+         b[1] /= unit.kG;
+         b[2] /= unit.kG;
+         reg.kind = FieldEngine::kUniform;
+      }
+      else if (compTagL->getLength() > 0)
+      {
+         DOMElement* compEl = (DOMElement*)compTagL->item(0);
+         reg.function = XString(compEl->getAttribute(X("function")));
+         reg.scale = 1 / Units::forElement(compEl).kG;
+         std::map<std::string,FieldFunction>::const_iterator iter;
+         iter = fEngine.fFunctions.find(reg.function);
+         reg.func = (iter == fEngine.fFunctions.end())? 0 : iter->second;
+         reg.kind = FieldEngine::kComputed;
+      }
+      else if (mapfTagL->getLength() > 0)
+      {
+         DOMElement* mapfEl = (DOMElement*)mapfTagL->item(0);
+         reg.scale = 1 / Units::forElement(mapfEl).kG;
+         reg.map = addMap(mapfEl);
+         reg.kind = FieldEngine::kMapped;
+         if (reg.map < 0)
+         {
+            fOk = false;
+            continue;
+         }
+      }
+
+      for (unsigned int imap=0; imap < maps.size(); ++imap)
+      {
+         int id = maps[imap].id;
+         for (int i = 0; i < 3; ++i)
+         {
+            reg.origin[i] = maps[imap].origin[i];
+            for (int j = 0; j < 3; ++j)
+            {
+               reg.Rmatrix[i][j] = maps[imap].Rmatrix[i][j];
+            }
+         }
+         for (int i = 0; i < 3; ++i)
+         {
+            reg.B[i] = reg.Rmatrix[i][0] * b[0] + reg.Rmatrix[i][1] * b[1]
+                     + reg.Rmatrix[i][2] * b[2];
+         }
+         if ((int)fEngine.fRegions.size() < id)
+         {
+            fEngine.fRegions.resize(id);
+         }
+         fEngine.fRegions[id - 1] = reg;
+      }
+   }
+}
+
+FieldEngine::Cache::Cache()
+ : map(0)
+{
+   cell[0] = cell[1] = cell[2] = -1;
+}
+
+FieldEngine::Map::Map()
+ : bricked(0),
+   octree(0)
+{
+   nsites[0] = nsites[1] = nsites[2] = 0;
+}
+
+FieldEngine::Map::~Map()
+{
+   delete bricked;
+   delete octree;
+}
+
+FieldEngine::Region::Region()
+ : kind(kNoField),
+   func(0),
+   scale(1),
+   map(-1)
+{
+   for (int i = 0; i < 3; ++i)
+   {
+      origin[i] = 0;
+      B[i] = 0;
+      for (int j = 0; j < 3; ++j)
+      {
+         Rmatrix[i][j] = (i == j)? 1 : 0;
+      }
+   }
+}
+
+FieldEngine::FieldEngine()
+{
+}
+
+FieldEngine::~FieldEngine()
+{
+   clear();
+}
+
+void FieldEngine::clear()
+{
+   for (unsigned int i = 0; i < fMaps.size(); ++i)
+   {
+      delete fMaps[i];
+   }
+   fMaps.clear();
+   fRegions.clear();
+}
+
+bool FieldEngine::build(DOMElement* topel)
+{
+   clear();
+   FieldCollector collector(*this);
+   collector.translate(topel);
+   if (! collector.isOk())
+   {
+      clear();
+      return false;
+   }
+   return true;
+}
+
+void FieldEngine::setFunction(const std::string& name, FieldFunction func)
+{
+   fFunctions[name] = func;
+   for (unsigned int i = 0; i < fRegions.size(); ++i)
+   {
+      if (fRegions[i].kind == kComputed && fRegions[i].function == name)
+      {
+         fRegions[i].func = func;
+      }
+   }
+}
+
+const std::string& FieldEngine::getRegionName(int region) const
+{
+   static const std::string none;
+   if (region < 1 || region > (int)fRegions.size())
+   {
+      return none;
+   }
+   return fRegions[region - 1].name;
+}
+
+bool FieldEngine::getField(int region, const double r[3], double B[3]) const
+{
+   Cache cache;
+   return getField(region, r, B, cache);
+}
+
+int FieldEngine::getField(int region, int n, const double* r, double* B)
+const
+{
+   Cache cache;
+   return getField(region, n, r, B, cache);
+}
+
+bool FieldEngine::getField(int region, const double r[3], double B[3],
+                           Cache& cache) const
+{
+   return (getField(region, 1, r, B, cache) == 1);
+}
+
+int FieldEngine::getField(int region, int n, const double* r, double* B,
+                          Cache& cache) const
+{
+   if (region < 1 || region > (int)fRegions.size())
+   {
+      memset(B, 0, n * 3 * sizeof(double));
+      return 0;
+   }
+   const Region& reg = fRegions[region - 1];
+   int inside = 0;
+   if (reg.kind == kNoField || reg.kind == kUniform)
+   {
+      for (int ip = 0; ip < n; ++ip)
+      {
+         B[3*ip] = reg.B[0];
+         B[3*ip+1] = reg.B[1];
+         B[3*ip+2] = reg.B[2];
+      }
+      inside = n;
+   }
+   else if (reg.kind == kComputed)
+   {
+      if (reg.func == 0)
+      {
+         memset(B, 0, n * 3 * sizeof(double));
+         return 0;
+      }
+      for (int ip = 0; ip < n; ++ip)
+      {
+         double* Bp = B + 3*ip;
+         reg.func(r + 3*ip, Bp);
+         Bp[0] *= reg.scale;
+         Bp[1] *= reg.scale;
+         Bp[2] *= reg.scale;
+      }
+      inside = n;
+   }
+   else
+   {
+      const Map& map = *fMaps[reg.map];
+      const double (*R)[3] = reg.Rmatrix;
+      for (int ip = 0; ip < n; ++ip)
+      {
+         const double* rp = r + 3*ip;
+         double rs[3], rr[3], BB[3];
+         rs[0] = rp[0] - reg.origin[0];
+         rs[1] = rp[1] - reg.origin[1];
+         rs[2] = rp[2] - reg.origin[2];
+         rr[0] = rs[0] * R[0][0] + rs[1] * R[1][0] + rs[2] * R[2][0];
+         rr[1] = rs[0] * R[0][1] + rs[1] * R[1][1] + rs[2] * R[2][1];
+         rr[2] = rs[0] * R[0][2] + rs[1] * R[1][2] + rs[2] * R[2][2];
+         inside += getMappedField(map, rr, BB, cache);
+         double* Bp = B + 3*ip;
+         Bp[0] = (R[0][0] * BB[0] + R[0][1] * BB[1] + R[0][2] * BB[2])
+                 * reg.scale;
+         Bp[1] = (R[1][0] * BB[0] + R[1][1] * BB[1] + R[1][2] * BB[2])
+                 * reg.scale;
+         Bp[2] = (R[2][0] * BB[0] + R[2][1] * BB[1] + R[2][2] * BB[2])
+                 * reg.scale;
+      }
+   }
+   return inside;
+}
+
+bool FieldEngine::getMappedField(const Map& map, const double r[3],
+                                 double B[3], Cache& cache) const
+{
+   for (unsigned int igrid = 0; igrid < map.grids.size(); ++igrid)
+   {
+      const Grid& grid = map.grids[igrid];
+      const FieldGrid& layout = grid.layout;
+      double p[3] = {r[0], r[1], r[2]};
+      int flip[3] = {1, 1, 1};
+      for (int i = 0; i < 3; ++i)
+      {
+         if (layout.mirror[i][0] != 0 &&
+             (p[i] - layout.lower[i]) * grid.invSpan[i] < 0)
+         {
+            p[i] = 2 * layout.lower[i] - p[i];
+            flip[0] *= layout.mirror[i][0];
+            flip[1] *= layout.mirror[i][1];
+            flip[2] *= layout.mirror[i][2];
+         }
+      }
+
+      double u[3];
+      double cosphi = 1;
+      double sinphi = 0;
+      if (layout.type == FieldGrid::kCylindrical)
+      {
+         double rho = sqrt(p[0]*p[0] + p[1]*p[1]);
+         double phi = atan2(p[1], p[0]);
+         u[0] = (rho - layout.lower[0]) * grid.invSpan[0];
+         u[1] = (phi - layout.lower[1]) * grid.invSpan[1];
+         u[1] -= (int)(u[1] / grid.alpha) * grid.alpha;
+         if (u[1] < 0)
+         {
+            u[1] += grid.alpha;
+         }
+         cosphi = cos(phi);
+         sinphi = sin(phi);
+      }
+      else if (layout.type == FieldGrid::kAxisymmetric)
+      {
+         double rho = sqrt(p[0]*p[0] + p[1]*p[1]);
+         u[0] = (rho - layout.lower[0]) * grid.invSpan[0];
+         u[1] = 0;
+         if (rho > 0)
+         {
+            cosphi = p[0] / rho;
+            sinphi = p[1] / rho;
+         }
+      }
+      else
+      {
+         u[0] = (p[0] - layout.lower[0]) * grid.invSpan[0];
+         u[1] = (p[1] - layout.lower[1]) * grid.invSpan[1];
+      }
+      u[2] = (p[2] - layout.lower[2]) * grid.invSpan[2];
+      if (u[0] < 0 || u[0] > 1 || u[1] < 0 || u[1] > 1 ||
+          u[2] < 0 || u[2] > 1)
+      {
+         continue;
+      }
+
+      double ur[3];
+      ur[0] = u[0] * grid.cells[0];
+      ur[1] = u[1] * grid.cells[1];
+      ur[2] = u[2] * grid.cells[2];
+      float Bmap[3];
+      interpolate(map, ur, Bmap, cache);
+      double Bg[3];
+      Bg[0] = Bmap[0] * layout.sense[0] * flip[0];
+      Bg[1] = Bmap[1] * layout.sense[1] * flip[1];
+      Bg[2] = Bmap[2] * layout.sense[2] * flip[2];
+      if (layout.type == FieldGrid::kCartesian)
+      {
+         B[0] = Bg[0];
+         B[1] = Bg[1];
+      }
+      else
+      {
+         B[0] = Bg[0] * cosphi - Bg[1] * sinphi;
+         B[1] = Bg[1] * cosphi + Bg[0] * sinphi;
+      }
+      B[2] = Bg[2];
+      return true;
+   }
+   B[0] = B[1] = B[2] = 0;
+   return false;
+}
+
+void FieldEngine::interpolate(const Map& map, const double ur[3],
+                              float B[3], Cache& cache) const
+{
+   if (map.octree != 0)
+   {
+      float x[3] = {(float)ur[0], (float)ur[1], (float)ur[2]};
+      map.octree->interpolateSite(x, B);
+      return;
+   }
+
+   int cell[3], step[3];
+   float t[3];
+   for (int i = 0; i < 3; ++i)
+   {
+      int top = map.nsites[i] - 2;	// last cell with an upper site
+      int c = (int)ur[i];
+      cell[i] = (c < top)? c : (top > 0)? top : 0;
+      step[i] = (top < 0)? 0 : 1;
+      t[i] = ur[i] - cell[i];
+   }
+
+   if (cache.map != &map || cache.cell[0] != cell[0] ||
+       cache.cell[1] != cell[1] || cache.cell[2] != cell[2])
+   {
+      for (int k = 0; k < 8; ++k)
+      {
+         map.site(cell[0] + (k & 1) * step[0],
+                  cell[1] + ((k >> 1) & 1) * step[1],
+                  cell[2] + ((k >> 2) & 1) * step[2], cache.corner[k]);
+         cache.corner[k][3] = 0;
+      }
+      cache.map = &map;
+      cache.cell[0] = cell[0];
+      cache.cell[1] = cell[1];
+      cache.cell[2] = cell[2];
+   }
+
+   const float (*c)[4] = cache.corner;
+#ifdef __SSE__
+   __m128 tx = _mm_set1_ps(t[0]);
+   __m128 ty = _mm_set1_ps(t[1]);
+   __m128 tz = _mm_set1_ps(t[2]);
+   __m128 c00 = lerp(_mm_loadu_ps(c[0]), _mm_loadu_ps(c[1]), tx);
+   __m128 c10 = lerp(_mm_loadu_ps(c[2]), _mm_loadu_ps(c[3]), tx);
+   __m128 c01 = lerp(_mm_loadu_ps(c[4]), _mm_loadu_ps(c[5]), tx);
+   __m128 c11 = lerp(_mm_loadu_ps(c[6]), _mm_loadu_ps(c[7]), tx);
+   float result[4];
+   _mm_storeu_ps(result, lerp(lerp(c00, c10, ty), lerp(c01, c11, ty), tz));
+   B[0] = result[0];
+   B[1] = result[1];
+   B[2] = result[2];
+#else
+   for (int i = 0; i < 3; ++i)
+   {
+      float c00 = c[0][i] + t[0] * (c[1][i] - c[0][i]);
+      float c10 = c[2][i] + t[0] * (c[3][i] - c[2][i]);
+      float c01 = c[4][i] + t[0] * (c[5][i] - c[4][i]);
+      float c11 = c[6][i] + t[0] * (c[7][i] - c[6][i]);
+      float cy0 = c00 + t[1] * (c10 - c00);
+      float cy1 = c01 + t[1] * (c11 - c01);
+      B[i] = cy0 + t[2] * (cy1 - cy0);
+   }
+#endif
+}
@@ -0,0 +1,197 @@
+/*  HDDS Field Engine
+ *
+ *  Original version - October 17, 2026.
+ *
+ */
+
+#ifndef SAW_HDDSFIELD_DEF
+#define SAW_HDDSFIELD_DEF true
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <xercesc/dom/DOM.hpp>
+
+using namespace xercesc;
+
+#include "hddsFieldMap.hpp"
+
+typedef void (*FieldFunction)(const double r[3], double B[3]);
+
+class FieldGrid
+{
+ /* The FieldGrid class holds the layout of one grid element of a
+  * mappedBfield: the grid type, the number of samples and the bounds
+  * along each grid axis, the sense of the field component along it, and
+  * the order in which the axes are nested in the map file.  The grid
+  * axes are x,y,z for a cartesian grid and r,phi,z for a cylindrical
+  * one, numbered 0,1,2.  Bounds are in cm, or in radians for phi.  An
+  * axisymmetric grid is sampled in r and z only, and is held as a
+  * cylindrical grid with a single sample in phi that is nested inside
+  * the other two.  A mirror along an axis extends the grid to the mirror
+  * image of its range through the plane at the first bound, with the
+  * field components there multiplied by the signs in mirror[axis].
+  */
+ public:
+   enum Type
+   {
+      kCartesian,
+      kCylindrical,
+      kAxisymmetric
+   };
+
+   Type type;
+   int nsites[3];			// samples along each grid axis
+   int axis[3];				// grid axis at each nesting level,
+					// outermost first
+   double lower[3];			// bound at the first sample
+   double upper[3];			// bound at the last sample
+   int sense[3];			// 1 forward, -1 reverse
+   int mirror[3][3];			// component signs in the mirror image
+					// along each axis, 0 if no mirror
+
+   static bool read(DOMElement* mapfEl,	// grids of a mappedBfield,
+                    std::vector<FieldGrid>& grids, // false on error
+                    std::string& error);
+
+   bool readText(const std::string& path, // plain-text map into values,
+                 std::vector<float>& values, // as Bmap(3,n1,n2,n3),
+                 std::string& error) const; // false on error
+};
+
+class FieldEngine
+{
+ /* The FieldEngine class evaluates the magnetic field described by the
+  * regions of a hdds document, for C++ code that does not link the
+  * generated gufld routines.  build() walks the geometry the same way
+  * the translators do, so the regions are numbered exactly as the
+  * iregion values of the generated code, and each number stands for
+  * one application of a region with its own origin and orientation.
+  * Positions are given in the MRS in cm and fields are returned in kG.
+  *
+  * Mapped fields are interpolated trilinearly between the eight sites
+  * around the point, with the inverse grid spacings worked out once in
+  * build().  The eight sites are kept in a Cache, so that a point that
+  * falls in the same cell as the one before it costs no lookups in the
+  * map at all; the batch form of getField() keeps one cache for all of
+  * its points.  Maps in the octree encoding carry their own cells and
+  * are interpolated between the corners of the leaf around the point,
+  * without the cache.  A computedBfield is evaluated by the function that
+  * was registered under its name with setFunction().
+  *
+  * The overloads of getField() without a Cache argument start from an
+  * empty cache of their own on every call, so they are safe to call
+  * from several threads at once but only the batch form gains from it.
+  * Callers that evaluate points one at a time should keep a Cache, one
+  * per thread, and start a new one after build() or clear().
+  */
+ public:
+   struct Cache
+   {
+      Cache();
+      const void* map;			// map of the cached cell, 0 if none
+      int cell[3];			// lower site of the cached cell
+      float corner[8][4];		// field at its corners, padded
+   };
+
+   FieldEngine();
+   ~FieldEngine();
+
+   bool build(DOMElement* topel);	// regions of a document, false
+					// on error
+   void clear();
+   void setFunction(const std::string& name, // implementation of
+                    FieldFunction func);     // a computedBfield
+
+   int getRegionCount() const;		// regions are numbered 1..n
+   const std::string& getRegionName(int region) const;
+
+   bool getField(int region, const double r[3], double B[3]) const;
+   bool getField(int region, const double r[3], double B[3],
+                 Cache& cache) const;	// false outside the field region
+   int getField(int region, int n, const double* r, double* B) const;
+   int getField(int region, int n, const double* r, double* B,
+                Cache& cache) const;	// r and B hold n points of three
+					// components, returns the number
+					// of points inside the region
+
+ private:
+   friend class FieldCollector;
+
+   enum Kind
+   {
+      kNoField,
+      kUniform,
+      kComputed,
+      kMapped
+   };
+
+   struct Grid
+   {
+      FieldGrid layout;
+      double invSpan[3];		// 1 / (upper - lower)
+      int cells[3];			// nsites - 1
+      double alpha;			// period of phi in units of the span
+   };
+
+   struct Map
+   {
+      Map();
+      ~Map();
+      void site(int i1, int i2, int i3, float v[3]) const;
+
+      std::vector<Grid> grids;		// grids sharing the map data
+      int nsites[3];
+      std::vector<float> values;	// as Bmap(3,n1,n2,n3), or empty
+      BrickedFieldMap* bricked;		// bricked map file, or 0
+      OctreeFieldMap* octree;		// octree map file, or 0
+   };
+
+   struct Region
+   {
+      Region();
+      std::string name;
+      Kind kind;
+      double origin[3];			// origin of the region in the MRS
+      double Rmatrix[3][3];		// rotation matrix (region -> MRS)
+      double B[3];			// uniform field in the MRS (kG)
+      std::string function;		// name of the computedBfield
+      FieldFunction func;		// its implementation, or 0
+      double scale;			// kG per unit of the field element
+      int map;				// index into fMaps
+   };
+
+   std::vector<Region> fRegions;	// region n is at index n-1
+   std::vector<Map*> fMaps;
+   std::map<std::string,FieldFunction> fFunctions;
+
+   bool getMappedField(const Map& map, const double r[3], double B[3],
+                       Cache& cache) const;
+   void interpolate(const Map& map, const double ur[3], float B[3],
+                    Cache& cache) const;
+
+   FieldEngine(const FieldEngine&);
+   void operator=(const FieldEngine&);
+};
+
+inline void FieldEngine::Map::site(int i1, int i2, int i3, float v[3]) const
+{
+   if (bricked != 0)
+   {
+      bricked->get(i1, i2, i3, v);
+      return;
+   }
+   const float* b = &values[(((size_t)i3 * nsites[1] + i2) * nsites[0] + i1)
+                            * 3];
+   v[0] = b[0];
+   v[1] = b[1];
+   v[2] = b[2];
+}
+
+inline int FieldEngine::getRegionCount() const
+{
+   return fRegions.size();
+}
+
+#endif
@@ -0,0 +1,1057 @@
+/*  HDDS Field Map
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Implementation Notes:
+ *  ---------------------
+ * 1. A bricked map file is a binary image in the byte order of the host
+ *    that wrote it.  It starts with a header of magic string, format
+ *    version, byte order mark, grid size, brick size and precision, and
+ *    the field data follow at the first page boundary.  The grid is cut
+ *    into bricks whose edges are powers of two, no longer than the brick
+ *    size and no longer than the power of two that covers the samples
+ *    along the axis, ordered with the brick index along grid axis 1
+ *    running fastest, then 2, then 3.  Inside a brick the points are
+ *    ordered in the same way, with the three components of each point
+ *    stored next to each other.  Bricks along the upper edges of the grid
+ *    are padded to the full size with copies of their first point, so that
+ *    the position of any point follows from its indices by shifts and
+ *    masks alone.
+ * 2. A brick of kInt16 precision starts with the offsets and then the
+ *    scales of the three components as floats, followed by the 16-bit
+ *    steps of its points.  Every brick is padded to a multiple of eight
+ *    bytes, so that the floats at the start of the next one are aligned.
+ *    Version 2 files, which predate the precision field, hold zeros in
+ *    its place and read as kFloat.
+ * 3. The file is mapped with MADV_RANDOM, which stops the kernel from
+ *    reading ahead of the bricks that are touched.  A tracking job only
+ *    ever faults in the part of the map along the tracks it follows.
+ * 4. The interpolation is the same nearest site plus gradient estimate
+ *    as the interpol3 routine that the FortranWriter generates for maps
+ *    in utf-8 encoding, done in single precision, so switching a map to
+ *    the bricked encoding at kFloat precision does not change the field
+ *    that is returned.  The static form of interpolate() runs the same
+ *    code on an array in memory, which gives the reference to measure
+ *    the error of the reduced precisions against.
+ * 5. An octree map file has a header like that of a bricked map, followed
+ *    at the first page boundary by the nodes of the tree, the row index
+ *    and the vertices.  A node covers a box of samples, from lo to hi along
+ *    each axis, starting with the whole grid at the root.  An inner node
+ *    holds the index of its first child, and its children follow it in
+ *    turn, one for each half of the box along every axis where the box
+ *    has samples strictly inside it, split at (lo + hi) / 2, with the
+ *    first such axis running fastest.  The boxes of the children are
+ *    therefore implied by the point being looked up, and a lookup is a
+ *    walk down from the root.  A leaf is stored as -1, because the walk
+ *    that reaches it has already found its box and so the sites at its
+ *    eight corners.  The corners of all the leaves are stored once each
+ *    as vertices, in the order of their sites with grid axis 1 running
+ *    fastest, together with the axis 1 index of each vertex and a row
+ *    index that holds the first vertex of every row of sites along axis 1.
+ *    The two corners of a leaf in the same row are found by a binary
+ *    search of that row.  This costs one int per vertex and one per row,
+ *    where a table of the corners of every leaf would cost eight per leaf.
+ *    The tree is built top-down, and a box becomes a leaf when trilinear
+ *    interpolation between its corners reproduces every sample in it to
+ *    within the tolerance, so the tolerance bounds the error at the sites
+ *    of the original grid.
+ */
+
+#include "hddsFieldMap.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+#define APP_NAME "hddsFieldMap"
+
+#define HDDS_FIELDMAP_MAGIC "HDDSbmap"
+#define HDDS_FIELDMAP_VERSION 3
+#define HDDS_OCTREE_MAGIC "HDDSomap"
+#define HDDS_OCTREE_VERSION 2
+
+static const int kByteOrder = 0x01020304;
+static const int kDataOffset = 4096;	// field data start on a page
+static const int kMaxBrickShift = 6;	// up to 64^3 sites per brick
+
+struct FieldMapHeader
+{
+   char magic[12];			// HDDS_FIELDMAP_MAGIC, zero padded
+   int version;				// HDDS_FIELDMAP_VERSION
+   int byteOrder;			// kByteOrder as seen by the writer
+   int nsites[3];			// samples along grid axes 1,2,3
+   int brick;				// largest edge of a brick
+   int components;			// values per site, always 3
+   int dataOffset;			// file offset of the first brick
+   int precision;			// BrickedFieldMap::Precision
+};
+
+struct OctreeHeader
+{
+   char magic[12];			// HDDS_OCTREE_MAGIC, zero padded
+   int version;				// HDDS_OCTREE_VERSION
+   int byteOrder;			// kByteOrder as seen by the writer
+   int nsites[3];			// samples along grid axes 1,2,3
+   float tolerance;			// largest error at a site
+   int nodes;				// nodes of the tree, root first
+   int leaves;				// nodes that are leaves
+   int vertices;			// vertices, 3 components each
+   int dataOffset;			// file offset of the first node
+};
+
+class OctreeBuilder
+{
+ /* Builds the tree of an OctreeFieldMap from a dense map, see note 5.
+  */
+ public:
+   OctreeBuilder(const float* values, const int nsites[3], float tolerance);
+   void build(int node, const int lo[3], const int hi[3]);
+   void collect();			// fill rows, columns and vertices
+
+   std::vector<int> nodes;
+   int leaves;
+   std::vector<int> rows;
+   std::vector<int> columns;
+   std::vector<float> vertices;
+
+ private:
+   const float* fValues;
+   const int* fSites;
+   float fTolerance;
+   std::vector<char> fCorner;		// site is a corner of a leaf
+
+   const float* site(int i1, int i2, int i3) const;
+   bool fits(const int lo[3], const int hi[3]) const;
+};
+
+static int brickShift(int brick)
+{
+   for (int shift = 0; shift <= kMaxBrickShift; ++shift)
+   {
+      if (brick == (1 << shift))
+      {
+         return shift;
+      }
+   }
+   return -1;
+}
+
+static int brickShape(const int nsites[3], int shift, int shifts[3])
+{
+   // log2 of the brick edge along each axis, returns log2 of the number
+   // of sites in a brick
+   int total = 0;
+   for (int i = 0; i < 3; ++i)
+   {
+      shifts[i] = 0;
+      while (shifts[i] < shift && (1 << shifts[i]) < nsites[i])
+      {
+         ++shifts[i];
+      }
+      total += shifts[i];
+   }
+   return total;
+}
+
+static size_t brickBytes(BrickedFieldMap::Precision precision, int shift)
+{
+   // length of a brick of 2^shift sites, padded to 8 bytes
+   size_t sites = (size_t)1 << shift;
+   size_t bytes;
+   if (precision == BrickedFieldMap::kInt16)
+   {
+      bytes = 6 * sizeof(float) + 3 * sites * sizeof(unsigned short);
+   }
+   else if (precision == BrickedFieldMap::kHalf)
+   {
+      bytes = 3 * sites * sizeof(unsigned short);
+   }
+   else
+   {
+      bytes = 3 * sites * sizeof(float);
+   }
+   return (bytes + 7) & ~(size_t)7;
+}
+
+static unsigned short floatToHalf(float f)
+{
+   // rounds to the nearest half float, ties to even
+   unsigned int bits;
+   memcpy(&bits, &f, sizeof(bits));
+   unsigned short sign = (bits >> 16) & 0x8000;
+   int exp = (int)((bits >> 23) & 0xff) - 127 + 15;
+   unsigned int mant = bits & 0x7fffff;
+   if (((bits >> 23) & 0xff) == 0xff)
+   {
+      return sign | 0x7c00 | ((mant)? 0x200 : 0);	// inf or nan
+   }
+   else if (exp >= 31)
+   {
+      return sign | 0x7c00;
+   }
+   else if (exp <= 0)
+   {
+      if (exp < -10)
+      {
+         return sign;
+      }
+      mant |= 0x800000;
+      int shift = 14 - exp;
+      unsigned int h = mant >> shift;
+      unsigned int rest = mant & ((1u << shift) - 1);
+      unsigned int half = 1u << (shift - 1);
+      if (rest > half || (rest == half && (h & 1)))
+      {
+         ++h;
+      }
+      return sign | h;
+   }
+   unsigned int h = ((unsigned int)exp << 10) | (mant >> 13);
+   unsigned int rest = mant & 0x1fff;
+   if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+   {
+      ++h;				// may carry into the exponent
+   }
+   return sign | h;
+}
+
+template <class Sites>
+static void interpol3(const Sites& sites, const int nsites[3],
+                      const float u[3], float B[3])
+{
+   int ir[3], ir0[3], ir1[3];
+   float dur[3];
+   for (int i = 0; i < 3; ++i)
+   {
+      // 1-based site coordinate, rounded as in the Fortran original
+      float ur = u[i] * (nsites[i] - 1) + 1;
+      int nint = (int)lroundf(ur);
+      ir[i] = nint - 1;
+      ir0[i] = (ir[i] > 0)? ir[i] - 1 : 0;
+      ir1[i] = (ir[i] < nsites[i] - 1)? ir[i] + 1 : nsites[i] - 1;
+      dur[i] = (ur - nint) / (ir1[i] - ir0[i] + 1e-20f);
+   }
+   float b0[3], lo[3][3], hi[3][3];
+   sites.get(ir[0], ir[1], ir[2], b0);
+   sites.get(ir0[0], ir[1], ir[2], lo[0]);
+   sites.get(ir1[0], ir[1], ir[2], hi[0]);
+   sites.get(ir[0], ir0[1], ir[2], lo[1]);
+   sites.get(ir[0], ir1[1], ir[2], hi[1]);
+   sites.get(ir[0], ir[1], ir0[2], lo[2]);
+   sites.get(ir[0], ir[1], ir1[2], hi[2]);
+   for (int c = 0; c < 3; ++c)
+   {
+      B[c] = b0[c] + (hi[0][c] - lo[0][c]) * dur[0]
+                   + (hi[1][c] - lo[1][c]) * dur[1]
+                   + (hi[2][c] - lo[2][c]) * dur[2];
+   }
+}
+
+class ArraySites
+{
+ /* Sites of a map held as Bmap(3,n1,n2,n3) in memory, for interpol3
+  */
+ public:
+   ArraySites(const float* values, const int nsites[3])
+    : fValues(values), fSites(nsites) {}
+
+   void get(int i1, int i2, int i3, float v[3]) const
+   {
+      const float* b = fValues +
+                       (((size_t)i3 * fSites[1] + i2) * fSites[0] + i1) * 3;
+      v[0] = b[0];
+      v[1] = b[1];
+      v[2] = b[2];
+   }
+
+ private:
+   const float* fValues;
+   const int* fSites;
+};
+
+BrickedFieldMap::BrickedFieldMap()
+ : fBase(0),
+   fSize(0),
+   fData(0),
+   fBrick(0),
+   fPrecision(kFloat),
+   fBrickBytes(0)
+{
+   for (int i = 0; i < 3; ++i)
+   {
+      fSites[i] = 0;
+      fBricks[i] = 0;
+      fShift[i] = 0;
+      fMask[i] = 0;
+   }
+}
+
+BrickedFieldMap::~BrickedFieldMap()
+{
+   close();
+}
+
+static void* mapFile(const std::string& path, size_t header, size_t& size)
+{
+   // maps a file of at least header bytes read-only, 0 on error
+   int fd = ::open(path.c_str(), O_RDONLY);
+   if (fd < 0)
+   {
+      std::cerr
+           << APP_NAME << " error: cannot open field map " << path
+           << std::endl;
+      return 0;
+   }
+   struct stat st;
+   void* base = MAP_FAILED;
+   if (fstat(fd, &st) == 0 && (size_t)st.st_size >= header)
+   {
+      base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   }
+   ::close(fd);
+   if (base == MAP_FAILED)
+   {
+      std::cerr
+           << APP_NAME << " error: cannot map field map " << path
+           << std::endl;
+      return 0;
+   }
+   size = st.st_size;
+   return base;
+}
+
+bool BrickedFieldMap::open(const std::string& path)
+{
+   close();
+   size_t fileSize;
+   void* base = mapFile(path, sizeof(FieldMapHeader), fileSize);
+   if (base == 0)
+   {
+      return false;
+   }
+
+   const FieldMapHeader* header = (const FieldMapHeader*)base;
+   int shift = brickShift(header->brick);
+   size_t size = 0;
+   if (strncmp(header->magic, HDDS_FIELDMAP_MAGIC,
+               sizeof(header->magic)) == 0 &&
+       (header->version == HDDS_FIELDMAP_VERSION || header->version == 2) &&
+       header->byteOrder == kByteOrder &&
+       header->components == 3 &&
+       header->dataOffset >= (int)sizeof(FieldMapHeader) &&
+       header->precision >= kFloat && header->precision <= kHalf &&
+       header->nsites[0] > 0 && header->nsites[1] > 0 &&
+       header->nsites[2] > 0 && shift >= 0)
+   {
+      fPrecision = (Precision)header->precision;
+      fBrickBytes = brickBytes(fPrecision,
+                               brickShape(header->nsites, shift, fShift));
+      size = fBrickBytes;
+      for (int i = 0; i < 3; ++i)
+      {
+         fSites[i] = header->nsites[i];
+         fBricks[i] = ((fSites[i] - 1) >> fShift[i]) + 1;
+         fMask[i] = (1 << fShift[i]) - 1;
+         size *= fBricks[i];
+      }
+      size += header->dataOffset;
+   }
+   if (size == 0 || size > fileSize)
+   {
+      munmap(base, fileSize);
+      std::cerr
+           << APP_NAME << " error: " << path
+           << " is not a bricked field map that this host can read"
+           << std::endl;
+      return false;
+   }
+
+   madvise(base, fileSize, MADV_RANDOM);
+   fPath = path;
+   fBase = base;
+   fSize = fileSize;
+   fBrick = header->brick;
+   fData = (const char*)base + header->dataOffset;
+   return true;
+}
+
+void BrickedFieldMap::close()
+{
+   if (fBase != 0)
+   {
+      munmap(fBase, fSize);
+   }
+   fPath.clear();
+   fBase = 0;
+   fSize = 0;
+   fData = 0;
+}
+
+const char* BrickedFieldMap::getPrecisionName(Precision precision)
+{
+   switch (precision)
+   {
+      case kInt16:
+         return "int16";
+      case kHalf:
+         return "half";
+      default:
+         return "float";
+   }
+}
+
+void BrickedFieldMap::interpolate(const float u[3], float B[3]) const
+{
+   interpol3(*this, fSites, u, B);
+}
+
+void BrickedFieldMap::interpolate(const float* values, const int nsites[3],
+                                  const float u[3], float B[3])
+{
+   interpol3(ArraySites(values, nsites), nsites, u, B);
+}
+
+bool BrickedFieldMap::write(const std::string& path,
+                            const float* values,
+                            const int nsites[3],
+                            int brick,
+                            Precision precision)
+{
+   int shift = brickShift(brick);
+   if (shift < 0 || nsites[0] <= 0 || nsites[1] <= 0 || nsites[2] <= 0)
+   {
+      std::cerr
+           << APP_NAME << " error: cannot write a field map with brick size "
+           << brick << std::endl;
+      return false;
+   }
+   size_t nvalues = (size_t)nsites[0] * nsites[1] * nsites[2] * 3;
+   for (size_t i = 0; precision == kHalf && i < nvalues; ++i)
+   {
+      if (fabs(values[i]) > 65504)
+      {
+         std::cerr
+              << APP_NAME << " error: field value " << values[i]
+              << " is out of the range of half precision" << std::endl;
+         return false;
+      }
+   }
+
+   FieldMapHeader header;
+   memset(&header, 0, sizeof(header));
+   strncpy(header.magic, HDDS_FIELDMAP_MAGIC, sizeof(header.magic));
+   header.version = HDDS_FIELDMAP_VERSION;
+   header.byteOrder = kByteOrder;
+   header.nsites[0] = nsites[0];
+   header.nsites[1] = nsites[1];
+   header.nsites[2] = nsites[2];
+   header.brick = brick;
+   header.components = 3;
+   header.dataOffset = kDataOffset;
+   header.precision = precision;
+
+   std::stringstream tmpStr;
+   tmpStr << path << ".tmp" << getpid();
+   std::string tmpPath(tmpStr.str());
+   std::ofstream ofs(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+   ofs.write((const char*)&header, sizeof(header));
+   std::vector<char> pad(kDataOffset - sizeof(header), 0);
+   ofs.write(&pad[0], pad.size());
+
+   int shifts[3];
+   int edge[3];
+   int nbricks[3];
+   int sites = 1 << brickShape(nsites, shift, shifts);
+   std::vector<float> block(3 * sites);
+   std::vector<char> packed(brickBytes(precision, shifts[0] + shifts[1]
+                                                  + shifts[2]), 0);
+   for (int i = 0; i < 3; ++i)
+   {
+      edge[i] = 1 << shifts[i];
+      nbricks[i] = ((nsites[i] - 1) >> shifts[i]) + 1;
+   }
+   for (int b3 = 0; b3 < nbricks[2]; ++b3)
+   {
+      for (int b2 = 0; b2 < nbricks[1]; ++b2)
+      {
+         for (int b1 = 0; b1 < nbricks[0]; ++b1)
+         {
+            float* site = &block[0];
+            for (int j3 = 0; j3 < edge[2]; ++j3)
+            {
+               for (int j2 = 0; j2 < edge[1]; ++j2)
+               {
+                  for (int j1 = 0; j1 < edge[0]; ++j1, site += 3)
+                  {
+                     int i1 = (b1 << shifts[0]) + j1;
+                     int i2 = (b2 << shifts[1]) + j2;
+                     int i3 = (b3 << shifts[2]) + j3;
+                     if (i1 < nsites[0] && i2 < nsites[1] && i3 < nsites[2])
+                     {
+                        const float* v = values +
+                          (((size_t)i3 * nsites[1] + i2) * nsites[0] + i1) * 3;
+                        site[0] = v[0];
+                        site[1] = v[1];
+                        site[2] = v[2];
+                     }
+                     else
+                     {
+                        site[0] = block[0];	// keeps the range of the
+                        site[1] = block[1];	// brick for kInt16
+                        site[2] = block[2];
+                     }
+                  }
+               }
+            }
+            if (precision == kInt16)
+            {
+               float* offset = (float*)&packed[0];
+               float* scale = offset + 3;
+               unsigned short* q = (unsigned short*)(scale + 3);
+               for (int c = 0; c < 3; ++c)
+               {
+                  float lo = block[c];
+                  float hi = block[c];
+                  for (int n = 1; n < sites; ++n)
+                  {
+                     lo = (block[n * 3 + c] < lo)? block[n * 3 + c] : lo;
+                     hi = (block[n * 3 + c] > hi)? block[n * 3 + c] : hi;
+                  }
+                  offset[c] = lo;
+                  scale[c] = (hi - lo) / 65535;
+                  for (int n = 0; n < sites; ++n)
+                  {
+                     double step = (scale[c] > 0)?
+                                   (block[n * 3 + c] - lo) / scale[c] : 0;
+                     q[n * 3 + c] = (step > 65535)? 65535 :
+                                    (unsigned short)floor(step + 0.5);
+                  }
+               }
+            }
+            else if (precision == kHalf)
+            {
+               unsigned short* h = (unsigned short*)&packed[0];
+               for (int n = 0; n < sites * 3; ++n)
+               {
+                  h[n] = floatToHalf(block[n]);
+               }
+            }
+            else
+            {
+               memcpy(&packed[0], &block[0], block.size() * sizeof(float));
+            }
+            ofs.write(&packed[0], packed.size());
+         }
+      }
+   }
+   ofs.close();
+
+   if (! ofs.good() || rename(tmpPath.c_str(), path.c_str()) != 0)
+   {
+      remove(tmpPath.c_str());
+      std::cerr
+           << APP_NAME << " error: cannot write field map " << path
+           << std::endl;
+      return false;
+   }
+   return true;
+}
+
+OctreeBuilder::OctreeBuilder(const float* values, const int nsites[3],
+                             float tolerance)
+ : leaves(0),
+   fValues(values),
+   fSites(nsites),
+   fTolerance(tolerance),
+   fCorner((size_t)nsites[0] * nsites[1] * nsites[2], 0)
+{
+}
+
+const float* OctreeBuilder::site(int i1, int i2, int i3) const
+{
+   return fValues + (((size_t)i3 * fSites[1] + i2) * fSites[0] + i1) * 3;
+}
+
+void OctreeBuilder::collect()
+{
+   rows.assign(1, 0);
+   columns.clear();
+   vertices.clear();
+   const char* corner = &fCorner[0];
+   for (int i3 = 0; i3 < fSites[2]; ++i3)
+   {
+      for (int i2 = 0; i2 < fSites[1]; ++i2)
+      {
+         for (int i1 = 0; i1 < fSites[0]; ++i1)
+         {
+            if (*corner++)
+            {
+               const float* v = site(i1, i2, i3);
+               columns.push_back(i1);
+               vertices.push_back(v[0]);
+               vertices.push_back(v[1]);
+               vertices.push_back(v[2]);
+            }
+         }
+         rows.push_back(columns.size());
+      }
+   }
+}
+
+bool OctreeBuilder::fits(const int lo[3], const int hi[3]) const
+{
+   if (hi[0] - lo[0] < 2 && hi[1] - lo[1] < 2 && hi[2] - lo[2] < 2)
+   {
+      return true;			// no samples inside the box
+   }
+   const float* c[8];
+   for (int k = 0; k < 8; ++k)
+   {
+      c[k] = site((k & 1)? hi[0] : lo[0],
+                  (k & 2)? hi[1] : lo[1],
+                  (k & 4)? hi[2] : lo[2]);
+   }
+   float scale[3];
+   for (int i = 0; i < 3; ++i)
+   {
+      scale[i] = (hi[i] > lo[i])? 1.0f / (hi[i] - lo[i]) : 0;
+   }
+   for (int i3 = lo[2]; i3 <= hi[2]; ++i3)
+   {
+      float tz = (i3 - lo[2]) * scale[2];
+      for (int i2 = lo[1]; i2 <= hi[1]; ++i2)
+      {
+         float ty = (i2 - lo[1]) * scale[1];
+         for (int i1 = lo[0]; i1 <= hi[0]; ++i1)
+         {
+            float tx = (i1 - lo[0]) * scale[0];
+            const float* v = site(i1, i2, i3);
+            for (int m = 0; m < 3; ++m)
+            {
+               float c00 = c[0][m] + tx * (c[1][m] - c[0][m]);
+               float c10 = c[2][m] + tx * (c[3][m] - c[2][m]);
+               float c01 = c[4][m] + tx * (c[5][m] - c[4][m]);
+               float c11 = c[6][m] + tx * (c[7][m] - c[6][m]);
+               float cy0 = c00 + ty * (c10 - c00);
+               float cy1 = c01 + ty * (c11 - c01);
+               if (fabs(cy0 + tz * (cy1 - cy0) - v[m]) > fTolerance)
+               {
+                  return false;
+               }
+            }
+         }
+      }
+   }
+   return true;
+}
+
+void OctreeBuilder::build(int node, const int lo[3], const int hi[3])
+{
+   if (fits(lo, hi))
+   {
+      for (int k = 0; k < 8; ++k)
+      {
+         int i1 = (k & 1)? hi[0] : lo[0];
+         int i2 = (k & 2)? hi[1] : lo[1];
+         int i3 = (k & 4)? hi[2] : lo[2];
+         fCorner[((size_t)i3 * fSites[1] + i2) * fSites[0] + i1] = 1;
+      }
+      nodes[node] = -1;
+      ++leaves;
+      return;
+   }
+
+   // split in halves along every axis that has samples inside the box,
+   // the children are numbered with the first split axis running fastest
+   int mid[3];
+   int children = 1;
+   for (int i = 0; i < 3; ++i)
+   {
+      mid[i] = (hi[i] - lo[i] < 2)? -1 : (lo[i] + hi[i]) / 2;
+      children *= (mid[i] < 0)? 1 : 2;
+   }
+   int first = nodes.size();
+   nodes[node] = first;
+   nodes.resize(first + children);
+   for (int child = 0; child < children; ++child)
+   {
+      int clo[3], chi[3];
+      int bit = 0;
+      for (int i = 0; i < 3; ++i)
+      {
+         clo[i] = lo[i];
+         chi[i] = hi[i];
+         if (mid[i] >= 0)
+         {
+            if ((child >> bit++) & 1)
+            {
+               clo[i] = mid[i];
+            }
+            else
+            {
+               chi[i] = mid[i];
+            }
+         }
+      }
+      build(first + child, clo, chi);
+   }
+}
+
+OctreeFieldMap::OctreeFieldMap()
+ : fBase(0),
+   fSize(0),
+   fNodes(0),
+   fRows(0),
+   fColumns(0),
+   fVertices(0),
+   fTolerance(0),
+   fNodeCount(0),
+   fLeafCount(0),
+   fVertexCount(0)
+{
+   fSites[0] = fSites[1] = fSites[2] = 0;
+}
+
+OctreeFieldMap::~OctreeFieldMap()
+{
+   close();
+}
+
+bool OctreeFieldMap::open(const std::string& path)
+{
+   close();
+   size_t fileSize;
+   void* base = mapFile(path, sizeof(OctreeHeader), fileSize);
+   if (base == 0)
+   {
+      return false;
+   }
+
+   const OctreeHeader* header = (const OctreeHeader*)base;
+   size_t rows = 0;
+   size_t size = 0;
+   if (strncmp(header->magic, HDDS_OCTREE_MAGIC,
+               sizeof(header->magic)) == 0 &&
+       header->version == HDDS_OCTREE_VERSION &&
+       header->byteOrder == kByteOrder &&
+       header->dataOffset >= (int)sizeof(OctreeHeader) &&
+       header->nsites[0] > 0 && header->nsites[1] > 0 &&
+       header->nsites[2] > 0 && header->nodes > 0 &&
+       header->leaves > 0 && header->vertices > 0)
+   {
+      rows = (size_t)header->nsites[1] * header->nsites[2];
+      size = header->dataOffset
+           + ((size_t)header->nodes + rows + 1) * sizeof(int)
+           + (size_t)header->vertices * (sizeof(int) + 3 * sizeof(float));
+   }
+   if (size > 0 && size <= fileSize)
+   {
+      const int* index = (const int*)((const char*)base + header->dataOffset)
+                       + header->nodes;
+      if (index[rows] != header->vertices)
+      {
+         size = 0;
+      }
+   }
+   if (size == 0 || size > fileSize)
+   {
+      munmap(base, fileSize);
+      std::cerr
+           << APP_NAME << " error: " << path
+           << " is not an octree field map that this host can read"
+           << std::endl;
+      return false;
+   }
+
+   madvise(base, fileSize, MADV_RANDOM);
+   fPath = path;
+   fBase = base;
+   fSize = fileSize;
+   for (int i = 0; i < 3; ++i)
+   {
+      fSites[i] = header->nsites[i];
+   }
+   fTolerance = header->tolerance;
+   fNodeCount = header->nodes;
+   fLeafCount = header->leaves;
+   fVertexCount = header->vertices;
+   fNodes = (const int*)((const char*)base + header->dataOffset);
+   fRows = fNodes + fNodeCount;
+   fColumns = fRows + rows + 1;
+   fVertices = (const float*)(fColumns + fVertexCount);
+   return true;
+}
+
+void OctreeFieldMap::close()
+{
+   if (fBase != 0)
+   {
+      munmap(fBase, fSize);
+   }
+   fPath.clear();
+   fBase = 0;
+   fSize = 0;
+   fNodes = 0;
+   fRows = 0;
+   fColumns = 0;
+   fVertices = 0;
+}
+
+void OctreeFieldMap::interpolate(const float u[3], float B[3]) const
+{
+   float x[3];
+   x[0] = u[0] * (fSites[0] - 1);
+   x[1] = u[1] * (fSites[1] - 1);
+   x[2] = u[2] * (fSites[2] - 1);
+   interpolateSite(x, B);
+}
+
+static void trilinear(const float* c[8], const float t[3], float B[3])
+{
+   for (int m = 0; m < 3; ++m)
+   {
+      float c00 = c[0][m] + t[0] * (c[1][m] - c[0][m]);
+      float c10 = c[2][m] + t[0] * (c[3][m] - c[2][m]);
+      float c01 = c[4][m] + t[0] * (c[5][m] - c[4][m]);
+      float c11 = c[6][m] + t[0] * (c[7][m] - c[6][m]);
+      float cy0 = c00 + t[1] * (c10 - c00);
+      float cy1 = c01 + t[1] * (c11 - c01);
+      B[m] = cy0 + t[2] * (cy1 - cy0);
+   }
+}
+
+void OctreeFieldMap::interpolateSite(const float x[3], float B[3]) const
+{
+   int lo[3], hi[3];
+   float xc[3];
+   for (int i = 0; i < 3; ++i)
+   {
+      lo[i] = 0;
+      hi[i] = fSites[i] - 1;
+      xc[i] = (x[i] < 0)? 0 : (x[i] > hi[i])? hi[i] : x[i];
+   }
+   int node = 0;
+   while (fNodes[node] >= 0)
+   {
+      int child = 0;
+      int bit = 0;
+      for (int i = 0; i < 3; ++i)
+      {
+         if (hi[i] - lo[i] >= 2)
+         {
+            int mid = (lo[i] + hi[i]) / 2;
+            if (xc[i] >= mid)
+            {
+               child |= 1 << bit;
+               lo[i] = mid;
+            }
+            else
+            {
+               hi[i] = mid;
+            }
+            ++bit;
+         }
+      }
+      node = fNodes[node] + child;
+   }
+
+   // the two corners of a leaf along axis 1 are in the same row
+   const float* c[8];
+   for (int k = 0; k < 8; k += 2)
+   {
+      size_t row = (size_t)((k & 4)? hi[2] : lo[2]) * fSites[1]
+                 + ((k & 2)? hi[1] : lo[1]);
+      const int* end = fColumns + fRows[row + 1];
+      const int* col = std::lower_bound(fColumns + fRows[row], end, lo[0]);
+      c[k] = fVertices + 3 * (col - fColumns);
+      col = std::lower_bound(col, end, hi[0]);
+      c[k + 1] = fVertices + 3 * (col - fColumns);
+   }
+   float t[3];
+   for (int i = 0; i < 3; ++i)
+   {
+      t[i] = (hi[i] > lo[i])? (xc[i] - lo[i]) / (hi[i] - lo[i]) : 0;
+   }
+   trilinear(c, t, B);
+}
+
+void OctreeFieldMap::interpolate(const float* values, const int nsites[3],
+                                 const float x[3], float B[3])
+{
+   int lo[3], hi[3];
+   float t[3];
+   for (int i = 0; i < 3; ++i)
+   {
+      int top = nsites[i] - 1;
+      float xc = (x[i] < 0)? 0 : (x[i] > top)? top : x[i];
+      lo[i] = (xc < top)? (int)xc : (top > 0)? top - 1 : 0;
+      hi[i] = (top > 0)? lo[i] + 1 : 0;
+      t[i] = xc - lo[i];
+   }
+   const float* c[8];
+   for (int k = 0; k < 8; ++k)
+   {
+      int i1 = (k & 1)? hi[0] : lo[0];
+      int i2 = (k & 2)? hi[1] : lo[1];
+      int i3 = (k & 4)? hi[2] : lo[2];
+      c[k] = values + (((size_t)i3 * nsites[1] + i2) * nsites[0] + i1) * 3;
+   }
+   trilinear(c, t, B);
+}
+
+bool OctreeFieldMap::write(const std::string& path,
+                           const float* values,
+                           const int nsites[3],
+                           float tolerance)
+{
+   if (nsites[0] <= 0 || nsites[1] <= 0 || nsites[2] <= 0 || tolerance < 0)
+   {
+      std::cerr
+           << APP_NAME << " error: cannot write an octree field map with "
+           << "tolerance " << tolerance << std::endl;
+      return false;
+   }
+
+   OctreeBuilder builder(values, nsites, tolerance);
+   int lo[3] = {0, 0, 0};
+   int hi[3] = {nsites[0] - 1, nsites[1] - 1, nsites[2] - 1};
+   builder.nodes.resize(1);
+   builder.build(0, lo, hi);
+   builder.collect();
+
+   OctreeHeader header;
+   memset(&header, 0, sizeof(header));
+   strncpy(header.magic, HDDS_OCTREE_MAGIC, sizeof(header.magic));
+   header.version = HDDS_OCTREE_VERSION;
+   header.byteOrder = kByteOrder;
+   header.nsites[0] = nsites[0];
+   header.nsites[1] = nsites[1];
+   header.nsites[2] = nsites[2];
+   header.tolerance = tolerance;
+   header.nodes = builder.nodes.size();
+   header.leaves = builder.leaves;
+   header.vertices = builder.vertices.size() / 3;
+   header.dataOffset = kDataOffset;
+
+   std::stringstream tmpStr;
+   tmpStr << path << ".tmp" << getpid();
+   std::string tmpPath(tmpStr.str());
+   std::ofstream ofs(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+   ofs.write((const char*)&header, sizeof(header));
+   std::vector<char> pad(kDataOffset - sizeof(header), 0);
+   ofs.write(&pad[0], pad.size());
+   ofs.write((const char*)&builder.nodes[0],
+             builder.nodes.size() * sizeof(int));
+   ofs.write((const char*)&builder.rows[0],
+             builder.rows.size() * sizeof(int));
+   ofs.write((const char*)&builder.columns[0],
+             builder.columns.size() * sizeof(int));
+   ofs.write((const char*)&builder.vertices[0],
+             builder.vertices.size() * sizeof(float));
+   ofs.close();
+
+   if (! ofs.good() || rename(tmpPath.c_str(), path.c_str()) != 0)
+   {
+      remove(tmpPath.c_str());
+      std::cerr
+           << APP_NAME << " error: cannot write field map " << path
+           << std::endl;
+      return false;
+   }
+   return true;
+}
+
+// Maps opened from Fortran, the handle of a map is its index plus one.
+
+static std::vector<BrickedFieldMap*> fortranBrickedMaps;
+static std::vector<OctreeFieldMap*> fortranOctreeMaps;
+
+template <class Map>
+static void openForFortran(std::vector<Map*>& maps,
+                           const char* name, const int* nsites, int* handle,
+                           size_t namelen)
+{
+   while (namelen > 0 && name[namelen - 1] == ' ')
+   {
+      --namelen;
+   }
+   std::string path(name, namelen);
+
+   *handle = 0;
+   for (unsigned int i = 0; i < maps.size(); ++i)
+   {
+      if (maps[i]->getPath() == path)
+      {
+         *handle = i + 1;
+         break;
+      }
+   }
+   if (*handle == 0)
+   {
+      Map* map = new Map();
+      if (! map->open(path))
+      {
+         delete map;
+         return;
+      }
+      maps.push_back(map);
+      *handle = maps.size();
+   }
+
+   const int* sites = maps[*handle - 1]->getSites();
+   if (sites[0] != nsites[0] || sites[1] != nsites[1] ||
+       sites[2] != nsites[2])
+   {
+      std::cerr
+           << APP_NAME << " error: field map " << path << " has "
+           << sites[0] << "x" << sites[1] << "x" << sites[2]
+           << " sites, but its mappedBfield expects "
+           << nsites[0] << "x" << nsites[1] << "x" << nsites[2]
+           << std::endl;
+      *handle = 0;
+   }
+}
+
+template <class Map>
+static void interpolateForFortran(const std::vector<Map*>& maps,
+                                  const int* handle, const float* u, float* B)
+{
+   if (*handle < 1 || *handle > (int)maps.size())
+   {
+      B[0] = B[1] = B[2] = 0;
+      return;
+   }
+   maps[*handle - 1]->interpolate(u, B);
+}
+
+void hddsbmapopen_(const char* name, const int* nsites, int* handle,
+                   size_t namelen)
+{
+   openForFortran(fortranBrickedMaps, name, nsites, handle, namelen);
+}
+
+void hddsbmapinterp_(const int* handle, const float* u, float* B)
+{
+   interpolateForFortran(fortranBrickedMaps, handle, u, B);
+}
+
+void hddsomapopen_(const char* name, const int* nsites, int* handle,
+                   size_t namelen)
+{
+   openForFortran(fortranOctreeMaps, name, nsites, handle, namelen);
+}
+
+void hddsomapinterp_(const int* handle, const float* u, float* B)
+{
+   interpolateForFortran(fortranOctreeMaps, handle, u, B);
+}
@@ -0,0 +1,286 @@
+/*  HDDS Field Map
+ *
+ *  Original version - October 17, 2026.
+ *
+ */
+
+#ifndef SAW_HDDSFIELDMAP_DEF
+#define SAW_HDDSFIELDMAP_DEF true
+
+#include <string>
+#include <stddef.h>
+#include <string.h>
+
+class BrickedFieldMap
+{
+ /* The BrickedFieldMap class gives access to a magnetic field map stored
+  * in the binary "bricked" encoding of a mappedBfield.  The map covers a
+  * grid of nsites(1) x nsites(2) x nsites(3) points, indexed by grid axis
+  * as in the Bmap array of the generated gufld routines, with the three
+  * field components stored at every point.  The points are grouped into
+  * bricks of up to brick points along each axis, so that the neighbours
+  * of a point are nearly always on the same page.  Along an axis with
+  * fewer samples than that, such as the phi axis of an axisymmetric
+  * grid, the bricks are only as long as they need to be.  The file is
+  * memory-mapped read-only by open(), which costs next to nothing, and
+  * only the pages of the bricks that are actually looked at are ever read
+  * from disk.  All of the processes on a node that open the same map
+  * share one copy of it in the page cache.
+  *
+  * The components can be stored at reduced precision to make the map,
+  * and the page cache it occupies, smaller.  kInt16 stores each component
+  * as a 16-bit step between the smallest and largest value of that
+  * component in the brick, so the error is at most half a step: 1/131070
+  * of the range of the component within the brick.  kHalf stores IEEE
+  * half floats, with a relative error of at most 2^-11 and a magnitude
+  * limit of 65504 in the units of the map.  Either takes half the space
+  * of kFloat, and the values are decoded as they are read by get().
+  */
+ public:
+   enum { kDefaultBrick = 8 };
+
+   enum Precision
+   {
+      kFloat,				// 32-bit floats, exact
+      kInt16,				// 16-bit steps, scale and offset
+					// per component in each brick
+      kHalf				// IEEE 754 half floats
+   };
+
+   BrickedFieldMap();
+   ~BrickedFieldMap();
+
+   bool open(const std::string& path);	// map file, false on error
+   void close();
+   bool isOpen() const;
+   const std::string& getPath() const;
+
+   const int* getSites() const;		// samples along grid axes 1,2,3
+   int getBrick() const;		// largest edge of a brick
+   Precision getPrecision() const;
+   static const char* getPrecisionName(Precision precision);
+
+   void get(int i1, int i2, int i3,	// 3 components of the point with
+            float v[3]) const;		// 0-based indices i1,i2,i3
+   void interpolate(const float u[3], float B[3]) const; // as interpol3
+
+   static void interpolate(const float* values, // as interpol3, from
+                           const int nsites[3], // Bmap(3,n1,n2,n3)
+                           const float u[3], float B[3]);
+   static bool write(const std::string& path,
+                     const float* values,	// as Bmap(3,n1,n2,n3)
+                     const int nsites[3],
+                     int brick = kDefaultBrick,
+                     Precision precision = kFloat);
+
+ private:
+   std::string fPath;
+   void* fBase;				// start of the mapped file
+   size_t fSize;			// length of the mapping
+   const char* fData;			// first brick
+   int fSites[3];
+   int fBrick;				// largest edge of a brick
+   int fBricks[3];			// bricks along grid axes 1,2,3
+   int fShift[3];			// log2 of the brick edge along each axis
+   int fMask[3];			// brick edge - 1 along each axis
+   Precision fPrecision;
+   size_t fBrickBytes;			// length of a brick in the file
+
+   static float halfToFloat(unsigned short h);
+
+   BrickedFieldMap(const BrickedFieldMap&);
+   void operator=(const BrickedFieldMap&);
+};
+
+inline bool BrickedFieldMap::isOpen() const
+{
+   return (fData != 0);
+}
+
+inline const std::string& BrickedFieldMap::getPath() const
+{
+   return fPath;
+}
+
+inline const int* BrickedFieldMap::getSites() const
+{
+   return fSites;
+}
+
+inline int BrickedFieldMap::getBrick() const
+{
+   return fBrick;
+}
+
+inline BrickedFieldMap::Precision BrickedFieldMap::getPrecision() const
+{
+   return fPrecision;
+}
+
+inline float BrickedFieldMap::halfToFloat(unsigned short h)
+{
+   unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+   unsigned int exp = (h >> 10) & 0x1f;
+   unsigned int mant = h & 0x3ff;
+   unsigned int bits;
+   if (exp == 0)
+   {
+      float f = mant * (1.0f / 16777216);	// subnormal, mant * 2^-24
+      return (sign)? -f : f;
+   }
+   else if (exp == 31)
+   {
+      bits = sign | 0x7f800000 | (mant << 13);
+   }
+   else
+   {
+      bits = sign | ((exp + 112) << 23) | (mant << 13);
+   }
+   float f;
+   memcpy(&f, &bits, sizeof(f));
+   return f;
+}
+
+inline void BrickedFieldMap::get(int i1, int i2, int i3, float v[3]) const
+{
+   size_t brick = ((size_t)(i3 >> fShift[2]) * fBricks[1]
+                   + (i2 >> fShift[1])) * fBricks[0] + (i1 >> fShift[0]);
+   int site = ((((i3 & fMask[2]) << fShift[1]) + (i2 & fMask[1]))
+               << fShift[0]) + (i1 & fMask[0]);
+   const char* data = fData + brick * fBrickBytes;
+   if (fPrecision == kInt16)
+   {
+      const float* offset = (const float*)data;
+      const float* scale = offset + 3;
+      const unsigned short* q = (const unsigned short*)(scale + 3) + site * 3;
+      v[0] = offset[0] + scale[0] * q[0];
+      v[1] = offset[1] + scale[1] * q[1];
+      v[2] = offset[2] + scale[2] * q[2];
+   }
+   else if (fPrecision == kHalf)
+   {
+      const unsigned short* h = (const unsigned short*)data + site * 3;
+      v[0] = halfToFloat(h[0]);
+      v[1] = halfToFloat(h[1]);
+      v[2] = halfToFloat(h[2]);
+   }
+   else
+   {
+      const float* f = (const float*)data + site * 3;
+      v[0] = f[0];
+      v[1] = f[1];
+      v[2] = f[2];
+   }
+}
+
+class OctreeFieldMap
+{
+ /* The OctreeFieldMap class gives access to a magnetic field map stored
+  * in the binary "octree" encoding of a mappedBfield.  The grid of the
+  * map is cut in halves along each axis, recursively, until the field at
+  * every sample inside a box agrees with the trilinear interpolation
+  * between the eight corners of the box to within a tolerance.  Only the
+  * corners of these leaf boxes are kept, so a smooth field is described
+  * by a few large boxes and only the parts where it changes quickly are
+  * sampled at the full density of the original grid.  The size of the
+  * map follows the structure of the field rather than the volume of the
+  * grid.  The file is memory-mapped read-only by open(), as for a
+  * BrickedFieldMap, and write() builds the tree from a dense map.
+  */
+ public:
+   OctreeFieldMap();
+   ~OctreeFieldMap();
+
+   bool open(const std::string& path);	// map file, false on error
+   void close();
+   bool isOpen() const;
+   const std::string& getPath() const;
+
+   const int* getSites() const;		// samples along grid axes 1,2,3
+   float getTolerance() const;		// as given to write()
+   int getNodeCount() const;
+   int getLeafCount() const;
+   int getVertexCount() const;		// distinct corners of the leaves
+
+   void interpolate(const float u[3], float B[3]) const; // u in [0,1]
+   void interpolateSite(const float x[3],	// x in 0-based site
+                        float B[3]) const;	// units, 0..nsites-1
+
+   static void interpolate(const float* values, // trilinear, from
+                           const int nsites[3], // Bmap(3,n1,n2,n3)
+                           const float x[3], float B[3]);
+   static bool write(const std::string& path,
+                     const float* values,	// as Bmap(3,n1,n2,n3)
+                     const int nsites[3],
+                     float tolerance);		// largest error at a site,
+						// in the units of the map
+ private:
+   std::string fPath;
+   void* fBase;				// start of the mapped file
+   size_t fSize;			// length of the mapping
+   const int* fNodes;			// first child, or -1 for a leaf
+   const int* fRows;			// first vertex of each row of sites
+   const int* fColumns;			// axis 1 index of each vertex
+   const float* fVertices;		// 3 components per vertex
+   int fSites[3];
+   float fTolerance;
+   int fNodeCount;
+   int fLeafCount;
+   int fVertexCount;
+
+   OctreeFieldMap(const OctreeFieldMap&);
+   void operator=(const OctreeFieldMap&);
+};
+
+inline bool OctreeFieldMap::isOpen() const
+{
+   return (fNodes != 0);
+}
+
+inline const std::string& OctreeFieldMap::getPath() const
+{
+   return fPath;
+}
+
+inline const int* OctreeFieldMap::getSites() const
+{
+   return fSites;
+}
+
+inline float OctreeFieldMap::getTolerance() const
+{
+   return fTolerance;
+}
+
+inline int OctreeFieldMap::getNodeCount() const
+{
+   return fNodeCount;
+}
+
+inline int OctreeFieldMap::getLeafCount() const
+{
+   return fLeafCount;
+}
+
+inline int OctreeFieldMap::getVertexCount() const
+{
+   return fVertexCount;
+}
+
+// Entry points for the generated Fortran gufld routines, see the
+// "bricked" and "octree" encodings of mappedBfield in the schema.  The
+// handle of a map is 0 if it could not be opened.  The hidden length of
+// the CHARACTER argument is a size_t, as gfortran has passed it since
+// version 8.
+
+extern "C"
+{
+   void hddsbmapopen_(const char* name, const int* nsites, int* handle,
+                      size_t namelen);
+   void hddsbmapinterp_(const int* handle, const float* u, float* B);
+   void hddsomapopen_(const char* name, const int* nsites, int* handle,
+                      size_t namelen);
+   void hddsomapinterp_(const int* handle, const float* u, float* B);
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ *  hddsFortranWriter :   code writer class for the hdds-geant utility that
+ *                   writes out a GEANT-3 geometry description from a HDDS
+ *                   document in the form of a fortran subroutine.
+ *
+ *  Class definition
+ *  Split out of hdds-geant.cpp, October 17, 2026.
+ *  For the revision history of the writer see hdds-geant.cpp.
+ */
+
+#ifndef SAW_HDDSFORTRANWRITER_DEF
+#define SAW_HDDSFORTRANWRITER_DEF true
+
+#include <xercesc/dom/DOM.hpp>
+
+using namespace xercesc;
+
+#include "XString.hpp"
+#include "hddsCommon.hpp"
+
+class FortranWriter : public CodeWriter
+{
+ public:
+   void createHeader();
+   void createTrailer();
+   int createMaterial(DOMElement* el);   // generate code for materials
+   int createSolid(DOMElement* el,
+                   Refsys& ref);    	 // generate code for solids
+   int createRotation(Refsys& ref);      // generate code for rotations
+   int createRegion(DOMElement* el,
+                    Refsys& ref);        // generate code for regions
+   int createVolume(DOMElement* el,
+                    Refsys& ref);  	 // generate code for placement
+   int createDivision(XString& divStr,
+                      Refsys& ref);	 // generate code for divisions
+   void createSetFunctions(DOMElement* el,
+                  const XString& ident); // generate code for properties
+   void createGetFunctions(DOMElement* el,
+                  const XString& ident); // generate code for identifiers
+   void createMapFunctions(DOMElement* el,
+                  const XString& ident); // generate code for field maps
+   void createUtilityFunctions(DOMElement* el,
+                  const XString& ident); // generate utility functions
+};
+
+#endif
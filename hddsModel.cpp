@@ -0,0 +1,396 @@
+/*  HDDS Geometry Model
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Implementation Notes:
+ *  ---------------------
+ * 1. Placements are expanded copy by copy with Refsys::placeCopies(),
+ *    which CodeWriter::createVolume() also uses outside of divisions, so
+ *    the list of placements is the full set of physical volumes in the
+ *    geometry.  The parameters of each positioning tag are read from the
+ *    tag itself.
+ * 2. Neither the model nor a CodeWriter pass modifies the document, so
+ *    the model can be built before or after a translation.
+ * 3. Elements are looked up with loadElementById, so a lazily loaded
+ *    document gets its detector files parsed as the model reaches them.
+ *    When a target volume is given, only the placements that can lead to
+ *    it are expanded, which leaves the other detector files unparsed.
+ */
+
+#include "XString.hpp"
+#include "XParsers.hpp"
+#include "hddsModel.hpp"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#define APP_NAME "hddsModel"
+
+#define X(str) XName(str)
+#define S(str) str.c_str()
+
+static void collectAttributes(DOMElement* el,
+                              GeometryModel::AttributeList& attrs)
+{
+   DOMNamedNodeMap* attribL = el->getAttributes();
+   for (unsigned int i=0; i < attribL->getLength(); i++)
+   {
+      XString nameS(attribL->item(i)->getNodeName());
+      XString valueS(attribL->item(i)->getNodeValue());
+      attrs.push_back(std::make_pair(nameS, valueS));
+   }
+}
+
+GeometryModel::GeometryModel()
+{
+   fIdentStart.push_back(0);
+}
+
+void GeometryModel::clear()
+{
+   fIdentNames.clear();
+   fMaterials.clear();
+   fRegions.clear();
+   fVolumes.clear();
+   fParent.clear();
+   fVolume.clear();
+   fRegion.clear();
+   for (int i = 0; i < 3; i++)
+   {
+      fOrigin[i].clear();
+   }
+   for (int i = 0; i < 9; i++)
+   {
+      fRmatrix[i].clear();
+   }
+   fIdentStart.assign(1, 0);
+   fIdentField.clear();
+   fIdentValue.clear();
+   fVolumeIndex.clear();
+   fMaterialIndex.clear();
+   fRegionIndex.clear();
+   fIdentIndex.clear();
+}
+
+void GeometryModel::rebuildIndices()
+{
+   fVolumeIndex.clear();
+   for (unsigned int i = 0; i < fVolumes.size(); i++)
+   {
+      fVolumeIndex[fVolumes[i].name] = i;
+   }
+   fMaterialIndex.clear();
+   for (unsigned int i = 0; i < fMaterials.size(); i++)
+   {
+      fMaterialIndex[fMaterials[i].name] = i;
+   }
+   fRegionIndex.clear();
+   for (unsigned int i = 0; i < fRegions.size(); i++)
+   {
+      fRegionIndex[fRegions[i].name] = i;
+   }
+   fIdentIndex.clear();
+   for (unsigned int i = 0; i < fIdentNames.size(); i++)
+   {
+      fIdentIndex[fIdentNames[i]] = i;
+   }
+}
+
+int GeometryModel::getVolumeIndex(const std::string& name) const
+{
+   std::map<std::string,int>::const_iterator iter = fVolumeIndex.find(name);
+   return (iter == fVolumeIndex.end())? -1 : iter->second;
+}
+
+void GeometryModel::getPlacement(int ip, Refsys& ref) const
+{
+   for (int i = 0; i < 3; i++)
+   {
+      ref.fOrigin[i] = ref.fMOrigin[i] = fOrigin[i][ip];
+      for (int j = 0; j < 3; j++)
+      {
+         ref.fRmatrix[i][j] = ref.fMRmatrix[i][j] = fRmatrix[3*i+j][ip];
+      }
+   }
+   ref.clearIdentifiers();
+   for (int id = fIdentStart[ip]; id < fIdentStart[ip+1]; id++)
+   {
+      Refsys::VolIdent ident;
+      ident.value = fIdentValue[id];
+      ident.step = 0;
+      ref.fIdentifier[fIdentNames[fIdentField[id]]] = ident;
+   }
+}
+
+void GeometryModel::build(DOMElement* topel, const std::string& target)
+{
+   clear();
+   fTarget = target;
+   Refsys mrs;
+   buildVolume(topel, mrs, -1, -1);
+   fTarget.clear();
+}
+
+int GeometryModel::internIdent(const std::string& field)
+{
+   std::map<std::string,int>::iterator iter = fIdentIndex.find(field);
+   if (iter != fIdentIndex.end())
+   {
+      return iter->second;
+   }
+   fIdentNames.push_back(field);
+   return fIdentIndex[field] = fIdentNames.size() - 1;
+}
+
+int GeometryModel::internMaterial(DOMElement* el)
+{
+   XString nameS(el->getAttribute(X("name")));
+   std::map<std::string,int>::iterator iter = fMaterialIndex.find(nameS);
+   if (iter != fMaterialIndex.end())
+   {
+      return iter->second;
+   }
+   const Substance& subst = MaterialRegistry::get(el);
+   Material mat;
+   mat.name = nameS;
+   mat.a = subst.getAtomicWeight();
+   mat.z = subst.getAtomicNumber();
+   mat.density = subst.getDensity();
+   mat.radlen = subst.getRadLength();
+   mat.abslen = subst.getAbsLength();
+   mat.collen = subst.getColLength();
+   mat.dedx = subst.getMIdEdx();
+   fMaterials.push_back(mat);
+   return fMaterialIndex[nameS] = fMaterials.size() - 1;
+}
+
+int GeometryModel::internRegion(DOMElement* el)
+{
+   XString regionS(el->getAttribute(X("region")));
+   std::map<std::string,int>::iterator iter = fRegionIndex.find(regionS);
+   if (iter != fRegionIndex.end())
+   {
+      return iter->second;
+   }
+   Region reg;
+   reg.name = regionS;
+   DOMElement* regEl = loadElementById(el->getOwnerDocument(), regionS);
+   if (regEl != 0)
+   {
+      for (DOMNode* cont = regEl->getFirstChild();
+           cont != 0;
+           cont = cont->getNextSibling())
+      {
+         if (cont->getNodeType() == DOMNode::ELEMENT_NODE)
+         {
+            DOMElement* fieldEl = (DOMElement*) cont;
+            reg.type = XString(fieldEl->getTagName());
+            collectAttributes(fieldEl, reg.attributes);
+            break;
+         }
+      }
+   }
+   fRegions.push_back(reg);
+   return fRegionIndex[regionS] = fRegions.size() - 1;
+}
+
+int GeometryModel::internVolume(DOMElement* el)
+{
+   XString nameS(el->getAttribute(X("name")));
+   std::map<std::string,int>::iterator iter = fVolumeIndex.find(nameS);
+   if (iter != fVolumeIndex.end())
+   {
+      return iter->second;
+   }
+   Volume vol;
+   vol.name = nameS;
+   vol.tag = XString(el->getTagName());
+   vol.envelope = XString(el->getAttribute(X("envelope")));
+   vol.material = -1;
+   XString matS(el->getAttribute(X("material")));
+   if (matS.size() != 0)
+   {
+      DOMElement* matEl = loadElementById(el->getOwnerDocument(), matS);
+      if (matEl != 0)
+      {
+         vol.material = internMaterial(matEl);
+      }
+   }
+   collectAttributes(el, vol.attributes);
+   fVolumes.push_back(vol);
+   return fVolumeIndex[nameS] = fVolumes.size() - 1;
+}
+
+int GeometryModel::addPlacement(int parent, int volume, int region,
+                                const Refsys& ref)
+{
+   fParent.push_back(parent);
+   fVolume.push_back(volume);
+   fRegion.push_back(region);
+   for (int i = 0; i < 3; i++)
+   {
+      fOrigin[i].push_back(ref.fMOrigin[i]);
+      fRmatrix[3*i].push_back(ref.fMRmatrix[i][0]);
+      fRmatrix[3*i+1].push_back(ref.fMRmatrix[i][1]);
+      fRmatrix[3*i+2].push_back(ref.fMRmatrix[i][2]);
+   }
+   std::map<std::string,Refsys::VolIdent>::const_iterator iter;
+   for (iter = ref.fIdentifier.begin(); iter != ref.fIdentifier.end(); ++iter)
+   {
+      fIdentField.push_back(internIdent(iter->first));
+      fIdentValue.push_back(iter->second.value);
+   }
+   fIdentStart.push_back(fIdentField.size());
+   return fVolume.size() - 1;
+}
+
+int GeometryModel::buildVolume(DOMElement* el, Refsys& ref,
+                                 int parent, int region)
+{
+   XString nameS(el->getAttribute(X("name")));
+   DOMDocument* document = el->getOwnerDocument();
+
+   Refsys myRef(ref);
+   XString envS(el->getAttribute(X("envelope")));
+   if (envS.size() != 0)
+   {
+      DOMElement* env = loadElementById(document, envS);
+      for (DOMNode* cont = env->getFirstChild();
+           cont != 0;
+           cont = cont->getNextSibling())
+      {
+         if (cont->getNodeType() == DOMNode::ELEMENT_NODE &&
+             hddsTag((DOMElement*)cont) == kApplyTag)
+         {
+            region = internRegion((DOMElement*)cont);
+         }
+      }
+   }
+
+   int iplace = addPlacement(parent, internVolume(el), region, myRef);
+   if (hddsTag(el) != kCompositionTag)
+   {
+      return iplace;
+   }
+   if (envS.size() != 0)
+   {
+      myRef.clearIdentifiers();
+   }
+
+   for (DOMNode* cont = el->getFirstChild();
+        cont != 0;
+        cont = cont->getNextSibling())
+   {
+      if (cont->getNodeType() != DOMNode::ELEMENT_NODE)
+      {
+         continue;
+      }
+      DOMElement* contEl = (DOMElement*) cont;
+      HddsTag comd = hddsTag(contEl);
+      if (comd == kApplyTag)
+      {
+         region = internRegion(contEl);
+         continue;
+      }
+      XString targS(contEl->getAttribute(X("volume")));
+      if (fTarget.size() != 0 && targS != fTarget &&
+          ! mayReference(document, targS, fTarget))
+      {
+         continue;
+      }
+      DOMElement* targEl = loadElementById(document, targS);
+      if (targEl == 0)
+      {
+         std::cerr
+              << APP_NAME << " error: composition of volume " << S(nameS)
+              << " places unknown volume " << S(targS) << std::endl;
+         exit(1);
+      }
+
+      Refsys drs(myRef);
+      double origin[3] = {0, 0, 0};
+      double angle[3] = {0, 0, 0};
+      AttributeDecoder::get(contEl, "rot", angle, 3);
+      const Units& unit = Units::forElement(contEl);
+      angle[0] /= unit.rad;
+      angle[1] /= unit.rad;
+      angle[2] /= unit.rad;
+
+      for (DOMNode* ident = cont->getFirstChild();
+           ident != 0;
+           ident = ident->getNextSibling())
+      {
+         if (ident->getNodeType() != DOMNode::ELEMENT_NODE)
+         {
+            continue;
+         }
+         DOMElement* identEl = (DOMElement*) ident;
+         XString fieldS(identEl->getAttribute(X("field")));
+         XString valueS(identEl->getAttribute(X("value")));
+         XString stepS(identEl->getAttribute(X("step")));
+         Refsys::VolIdent id;
+         id.value = atoi(S(valueS));
+         id.step = atoi(S(stepS));
+         drs.fIdentifier[fieldS] = id;
+      }
+
+      double s = AttributeDecoder::value(contEl, "S") /unit.cm;
+      XString implrotS(contEl->getAttribute(X("impliedRot")));
+
+      if (comd == kPosXYZTag)
+      {
+         AttributeDecoder::get(contEl, "X_Y_Z", origin, 3);
+         origin[0] /= unit.cm;
+         origin[1] /= unit.cm;
+         origin[2] /= unit.cm;
+         drs.shift(origin);
+         drs.rotate(angle);
+         buildVolume(targEl, drs, iplace, region);
+      }
+      else if (comd == kPosRPhiZTag)
+      {
+         double r=0, phi=0, z=0;
+         AttributeDecoder::get(contEl, "R_Phi_Z", r, phi, z);
+         phi /= unit.rad;
+         r /= unit.cm;
+         z /= unit.cm;
+         origin[0] = r * cos(phi) - s * sin(phi);
+         origin[1] = r * sin(phi) + s * cos(phi);
+         origin[2] = z;
+         if (implrotS == "true" && (phi != 0))
+         {
+            angle[2] += phi;
+         }
+         drs.shift(origin);
+         drs.rotate(angle);
+         buildVolume(targEl, drs, iplace, region);
+      }
+      else if (comd == kMposPhiTag || comd == kMposRTag ||
+               comd == kMposXTag || comd == kMposYTag ||
+               comd == kMposZTag)
+      {
+         std::vector<Refsys::Placement> series;
+         bool rotated = Refsys::placeCopies(drs, contEl, angle, series);
+         drs.rotate(angle);
+         for (unsigned int inst = 0; inst < series.size(); inst++)
+         {
+            drs.place(series[inst], rotated);
+            buildVolume(targEl, drs, iplace, region);
+            drs.incrementIdentifiers();
+         }
+      }
+      else
+      {
+         XString comdS(contEl->getTagName());
+         std::cerr
+              << APP_NAME << " error: composition of volume " << S(nameS)
+              << " contains unknown tag " << S(comdS) << std::endl;
+         exit(1);
+      }
+   }
+   return iplace;
+}
@@ -0,0 +1,121 @@
+/*  HDDS Geometry Model
+ *
+ *  Original version - October 17, 2026.
+ *
+ */
+
+#ifndef SAW_HDDSMODEL_DEF
+#define SAW_HDDSMODEL_DEF true
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include <xercesc/dom/DOM.hpp>
+
+using namespace xercesc;
+
+#include "XString.hpp"
+#include "hddsCommon.hpp"
+
+class GeometryModel
+{
+ /* The GeometryModel class is a flattened image of the hdds geometry
+  * tree that is built once from the DOM and can be used after the DOM
+  * has been released.  It consists of
+  *
+  *   - a logical volume table, one entry per named solid or composition,
+  *     holding its tag, envelope, material and source attributes;
+  *   - a material table with the derived properties from Substance;
+  *   - a region table with the field description of each region;
+  *   - a placement array, one entry per physical volume, with the index
+  *     of the parent placement, the logical volume and the region.
+  *
+  * The transformations of the placements to the master reference system
+  * (MRS) are stored as structure-of-arrays: fOrigin[i][ip] is coordinate
+  * i of the origin of placement ip and fRmatrix[3*i+j][ip] is element
+  * (i,j) of its rotation matrix, with the same conventions as Refsys.
+  * The identifiers in effect at each placement are kept in compressed
+  * rows: placement ip owns entries fIdentStart[ip] .. fIdentStart[ip+1]-1
+  * of fIdentField and fIdentValue.  Placements are stored in depth-first
+  * order, so a parent always precedes its children.
+  */
+ public:
+   GeometryModel();
+
+   void build(DOMElement* topel,	// flatten the tree below topel,
+              const std::string& target = "");	// or only the part of
+						// it that holds target
+   void clear();
+   void rebuildIndices();		// after filling the tables directly
+
+   typedef std::vector<std::pair<std::string,std::string> > AttributeList;
+
+   struct Material
+   {
+      std::string name;
+      double a;				// atomic weight
+      double z;				// atomic number
+      double density;			// g/cm^3
+      double radlen;			// cm
+      double abslen;			// cm
+      double collen;			// cm
+      double dedx;			// MeV/g/cm^2
+   };
+
+   struct Region
+   {
+      std::string name;
+      std::string type;			// tag of the field element
+      AttributeList attributes;		// attributes of the field element
+   };
+
+   struct Volume
+   {
+      std::string name;
+      std::string tag;			// composition or solid type
+      std::string envelope;		// name of envelope, if any
+      int material;			// index into fMaterials, or -1
+      AttributeList attributes;		// attributes of the source element
+   };
+
+   std::vector<std::string> fIdentNames;// identifier field names
+   std::vector<Material> fMaterials;
+   std::vector<Region> fRegions;
+   std::vector<Volume> fVolumes;
+
+   std::vector<int> fParent;		// parent placement, or -1
+   std::vector<int> fVolume;		// index into fVolumes
+   std::vector<int> fRegion;		// index into fRegions, or -1
+   std::vector<double> fOrigin[3];	// origin in the MRS (cm)
+   std::vector<double> fRmatrix[9];	// rotation matrix (daughter -> MRS)
+   std::vector<int> fIdentStart;	// first identifier of each placement
+   std::vector<int> fIdentField;	// index into fIdentNames
+   std::vector<int> fIdentValue;	// identifier value
+
+   int getPlacementCount() const;
+   int getVolumeIndex(const std::string& name) const;  // -1 if unknown
+   void getPlacement(int ip, Refsys& ref) const;  // load MRS transformation
+                                                  // and identifiers into ref
+ private:
+   std::map<std::string,int> fVolumeIndex;
+   std::map<std::string,int> fMaterialIndex;
+   std::map<std::string,int> fRegionIndex;
+   std::map<std::string,int> fIdentIndex;
+   std::string fTarget;			// volume that build is looking for
+
+   int addPlacement(int parent, int volume, int region, const Refsys& ref);
+   int buildVolume(DOMElement* el, Refsys& ref,
+                   int parent, int region);	// place el and its contents
+   int internVolume(DOMElement* el);
+   int internMaterial(DOMElement* el);
+   int internRegion(DOMElement* el);
+   int internIdent(const std::string& field);
+};
+
+inline int GeometryModel::getPlacementCount() const
+{
+   return fVolume.size();
+}
+
+#endif
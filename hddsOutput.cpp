@@ -0,0 +1,499 @@
+/*  HDDS Output Sink
+ *
+ *  Original version - October 17, 2026.
+ *
+ *  Implementation Notes:
+ *  ---------------------
+ * 1. The whole output is kept in memory until close().  The generated
+ *    sources are a few MB at most, and holding them is what makes the
+ *    comparison with the existing file possible before anything on disk
+ *    is touched.
+ * 2. A changed file is written to a temporary file next to it and then
+ *    renamed into place, as for the geometry cache, so a reader never
+ *    sees a partially written source and a failed write leaves the old
+ *    one where it was.
+ * 3. The comparison of a compressed file is done on its uncompressed
+ *    content, so the result does not depend on the compression level
+ *    that was used to write it.  zlib writes a zero time stamp into the
+ *    gzip header, so equal content gives equal files.
+ * 4. The pipeline hooks in below the writers through the num_put facet of
+ *    the stream, which is where the stream inserters for numbers end up.
+ *    DeferredNumPut records the value and the formatting state of the
+ *    stream instead of formatting it, and resets the width as the standard
+ *    facet would.  Text and numbers reach the sink in the order they were
+ *    written, so the formatter thread only has to interleave them again.
+ *    The block at fHead belongs to the writer and the blocks from fTail
+ *    up to fHead belong to the formatter.  The indices only change with
+ *    fRingLock held, which also orders the block contents before the
+ *    index that hands the block over.  Either side sleeps on a condition
+ *    variable while the ring is full or empty.
+ */
+
+#include "hddsOutput.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <sstream>
+#include <locale>
+
+#define APP_NAME "hddsOutput"
+
+static const size_t kInitialSize = 1 << 22;	// 4 MB before first growth
+static const size_t kChunkSize = 1 << 16;	// read/compare block size
+static const size_t kBlockSize = 1 << 16;	// text per pipeline block
+static const size_t kBlockNumbers = 1 << 12;	// numbers per pipeline block
+
+class DeferredNumPut : public std::num_put<char>
+{
+ /* Stands in for the standard num_put facet on the stream of a pipelined
+  * OutputSink, and queues the numbers for the formatter thread.  Anything
+  * written while the stream is attached to some other streambuf, or not
+  * of a type handled here, is formatted in place by the standard facet.
+  */
+ public:
+   DeferredNumPut(OutputSink* sink) : fSink(sink) {}
+
+ protected:
+   iter_type do_put(iter_type out, std::ios_base& str, char fill,
+                    long v) const;
+   iter_type do_put(iter_type out, std::ios_base& str, char fill,
+                    unsigned long v) const;
+   iter_type do_put(iter_type out, std::ios_base& str, char fill,
+                    double v) const;
+
+ private:
+   OutputSink* fSink;
+
+   OutputSink* sinkOf(std::ios_base& str) const;
+};
+
+OutputSink* DeferredNumPut::sinkOf(std::ios_base& str) const
+{
+   // the facet is only ever imbued into the stream of fSink, but the
+   // stream may have been pointed at another streambuf since
+   std::ostream& os = fSink->fStream;
+   if (&str != &os || os.rdbuf() != fSink || ! fSink->fPipelined)
+   {
+      return 0;
+   }
+   return fSink;
+}
+
+DeferredNumPut::iter_type DeferredNumPut::do_put(iter_type out,
+                                                 std::ios_base& str,
+                                                 char fill, long v) const
+{
+   OutputSink* sink = sinkOf(str);
+   if (sink == 0)
+   {
+      return std::num_put<char>::do_put(out, str, fill, v);
+   }
+   OutputSink::Number num;
+   num.type = 'l';
+   num.lvalue = v;
+   sink->defer(num, str, fill);
+   return out;
+}
+
+DeferredNumPut::iter_type DeferredNumPut::do_put(iter_type out,
+                                                 std::ios_base& str,
+                                                 char fill,
+                                                 unsigned long v) const
+{
+   OutputSink* sink = sinkOf(str);
+   if (sink == 0)
+   {
+      return std::num_put<char>::do_put(out, str, fill, v);
+   }
+   OutputSink::Number num;
+   num.type = 'u';
+   num.uvalue = v;
+   sink->defer(num, str, fill);
+   return out;
+}
+
+DeferredNumPut::iter_type DeferredNumPut::do_put(iter_type out,
+                                                 std::ios_base& str,
+                                                 char fill, double v) const
+{
+   OutputSink* sink = sinkOf(str);
+   if (sink == 0)
+   {
+      return std::num_put<char>::do_put(out, str, fill, v);
+   }
+   OutputSink::Number num;
+   num.type = 'd';
+   num.dvalue = v;
+   sink->defer(num, str, fill);
+   return out;
+}
+
+class StringAppender : public std::streambuf
+{
+ /* Lets the formatter thread write straight into the output buffer.
+  */
+ public:
+   StringAppender(std::string& target) : fTarget(target) {}
+
+ protected:
+   int overflow(int c)
+   {
+      if (c != EOF)
+      {
+         fTarget += (char)c;
+      }
+      return 0;
+   }
+   std::streamsize xsputn(const char* s, std::streamsize n)
+   {
+      fTarget.append(s, n);
+      return n;
+   }
+
+ private:
+   std::string& fTarget;
+};
+
+OutputSink::OutputSink(const std::string& path)
+ : fPath(path),
+   fMode(compressionFor(path)),
+   fClosed(false),
+   fUnchanged(false),
+   fStream(this),
+   fHead(0),
+   fTail(0),
+   fDone(false),
+   fPipelined(false)
+{
+   fData.reserve(kInitialSize);
+}
+
+OutputSink::OutputSink(const std::string& path, Compression mode)
+ : fPath(path),
+   fMode(mode),
+   fClosed(false),
+   fUnchanged(false),
+   fStream(this),
+   fHead(0),
+   fTail(0),
+   fDone(false),
+   fPipelined(false)
+{
+   fData.reserve(kInitialSize);
+}
+
+OutputSink::~OutputSink()
+{
+   if (! fClosed)
+   {
+      close();
+   }
+}
+
+OutputSink::Compression OutputSink::compressionFor(const std::string& path)
+{
+   size_t len = path.size();
+   if (len > 3 && path.compare(len - 3, 3, ".gz") == 0)
+   {
+      return kGzip;
+   }
+   return kNone;
+}
+
+int OutputSink::overflow(int c)
+{
+   if (c != EOF)
+   {
+      char ch = c;
+      append(&ch, 1);
+   }
+   return 0;
+}
+
+std::streamsize OutputSink::xsputn(const char* s, std::streamsize n)
+{
+   append(s, n);
+   return n;
+}
+
+void OutputSink::append(const char* s, size_t n)
+{
+   if (! fPipelined)
+   {
+      fData.append(s, n);
+      return;
+   }
+   Block& block = fRing[fHead % kRingSize];
+   block.text.append(s, n);
+   if (block.text.size() >= kBlockSize)
+   {
+      publish();
+   }
+}
+
+void OutputSink::defer(Number& num, std::ios_base& str, char fill)
+{
+   Block& block = fRing[fHead % kRingSize];
+   num.offset = block.text.size();
+   num.flags = str.flags();
+   num.precision = str.precision();
+   num.width = str.width(0);
+   num.fill = fill;
+   block.numbers.push_back(num);
+   if (block.numbers.size() >= kBlockNumbers)
+   {
+      publish();
+   }
+}
+
+void OutputSink::publish()
+{
+   pthread_mutex_lock(&fRingLock);
+   ++fHead;
+   pthread_cond_signal(&fRingFilled);
+   while (fHead - fTail >= (unsigned int)kRingSize)
+   {
+      pthread_cond_wait(&fRingEmptied, &fRingLock);
+   }
+   pthread_mutex_unlock(&fRingLock);
+}
+
+void OutputSink::drain()
+{
+   StringAppender appender(fData);
+   std::ostream out(&appender);
+   out.imbue(std::locale(fStream.getloc(), new std::num_put<char>));
+   pthread_mutex_lock(&fRingLock);
+   while (true)
+   {
+      while (fTail == fHead && ! fDone)
+      {
+         pthread_cond_wait(&fRingFilled, &fRingLock);
+      }
+      if (fTail == fHead)
+      {
+         break;
+      }
+      Block& block = fRing[fTail % kRingSize];
+      pthread_mutex_unlock(&fRingLock);
+      size_t pos = 0;
+      for (size_t i = 0; i < block.numbers.size(); i++)
+      {
+         const Number& num = block.numbers[i];
+         fData.append(block.text, pos, num.offset - pos);
+         pos = num.offset;
+         out.flags(num.flags);
+         out.precision(num.precision);
+         out.width(num.width);
+         out.fill(num.fill);
+         if (num.type == 'l')
+         {
+            out << num.lvalue;
+         }
+         else if (num.type == 'u')
+         {
+            out << num.uvalue;
+         }
+         else
+         {
+            out << num.dvalue;
+         }
+      }
+      fData.append(block.text, pos, std::string::npos);
+      block.text.clear();
+      block.numbers.clear();
+      pthread_mutex_lock(&fRingLock);
+      ++fTail;
+      pthread_cond_signal(&fRingEmptied);
+   }
+   pthread_mutex_unlock(&fRingLock);
+}
+
+void* OutputSink::formatter(void* sink)
+{
+   ((OutputSink*)sink)->drain();
+   return 0;
+}
+
+bool OutputSink::startPipeline()
+{
+   if (fPipelined || fClosed)
+   {
+      return fPipelined;
+   }
+   else if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+   {
+      return false;		// nothing to overlap with on one cpu
+   }
+   fStream.imbue(std::locale(fStream.getloc(), new DeferredNumPut(this)));
+   fHead = fTail = 0;
+   fDone = false;
+   fPipelined = true;
+   pthread_mutex_init(&fRingLock, 0);
+   pthread_cond_init(&fRingFilled, 0);
+   pthread_cond_init(&fRingEmptied, 0);
+   if (pthread_create(&fFormatter, 0, formatter, this) != 0)
+   {
+      pthread_cond_destroy(&fRingEmptied);
+      pthread_cond_destroy(&fRingFilled);
+      pthread_mutex_destroy(&fRingLock);
+      fPipelined = false;
+   }
+   return fPipelined;
+}
+
+int OutputSink::sync()
+{
+   // nothing is written before close(), so there is nothing to flush
+   return 0;
+}
+
+bool OutputSink::close()
+{
+   if (fClosed)
+   {
+      return true;
+   }
+   fClosed = true;
+   fUnchanged = false;
+   if (fPipelined)
+   {
+      publish();
+      pthread_mutex_lock(&fRingLock);
+      fDone = true;
+      pthread_cond_signal(&fRingFilled);
+      pthread_mutex_unlock(&fRingLock);
+      pthread_join(fFormatter, 0);
+      pthread_cond_destroy(&fRingEmptied);
+      pthread_cond_destroy(&fRingFilled);
+      pthread_mutex_destroy(&fRingLock);
+      fPipelined = false;
+   }
+
+   if (fPath == "-")
+   {
+      std::cout.flush();
+      const char* p = fData.data();
+      size_t left = fData.size();
+      while (left > 0)
+      {
+         ssize_t n = write(1, p, left);
+         if (n <= 0)
+         {
+            std::cerr
+                 << APP_NAME << " error: cannot write to standard output"
+                 << std::endl;
+            return false;
+         }
+         p += n;
+         left -= n;
+      }
+      return true;
+   }
+
+   if (matchesFile())
+   {
+      fUnchanged = true;
+      return true;
+   }
+
+   std::stringstream tmpStr;
+   tmpStr << fPath << ".tmp" << getpid();
+   std::string tmpPath(tmpStr.str());
+   if (! writeFile(tmpPath) || rename(tmpPath.c_str(), fPath.c_str()) != 0)
+   {
+      remove(tmpPath.c_str());
+      std::cerr
+           << APP_NAME << " error: cannot write output file " << fPath
+           << std::endl;
+      return false;
+   }
+   return true;
+}
+
+bool OutputSink::matchesFile() const
+{
+   std::string buf(kChunkSize, 0);
+   size_t pos = 0;
+   bool match = true;
+   if (fMode == kGzip)
+   {
+      gzFile gz = gzopen(fPath.c_str(), "rb");
+      if (gz == 0)
+      {
+         return false;
+      }
+      int n;
+      while (match && (n = gzread(gz, &buf[0], kChunkSize)) > 0)
+      {
+         match = (pos + n <= fData.size() &&
+                  fData.compare(pos, n, buf, 0, n) == 0);
+         pos += n;
+      }
+      match = match && (n == 0);
+      gzclose(gz);
+   }
+   else
+   {
+      int fd = open(fPath.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+         return false;
+      }
+      ssize_t n;
+      while (match && (n = read(fd, &buf[0], kChunkSize)) > 0)
+      {
+         match = (pos + n <= fData.size() &&
+                  fData.compare(pos, n, buf, 0, n) == 0);
+         pos += n;
+      }
+      match = match && (n == 0);
+      ::close(fd);
+   }
+   return match && (pos == fData.size());
+}
+
+bool OutputSink::writeFile(const std::string& path) const
+{
+   const char* p = fData.data();
+   size_t left = fData.size();
+   if (fMode == kGzip)
+   {
+      gzFile gz = gzopen(path.c_str(), "wb");
+      if (gz == 0)
+      {
+         return false;
+      }
+      bool ok = true;
+      while (ok && left > 0)
+      {
+         unsigned int len = (left < kInitialSize)? left : kInitialSize;
+         ok = (gzwrite(gz, p, len) == (int)len);
+         p += len;
+         left -= len;
+      }
+      return (gzclose(gz) == Z_OK) && ok;
+   }
+
+   int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (fd < 0)
+   {
+      return false;
+   }
+   while (left > 0)
+   {
+      ssize_t n = write(fd, p, left);
+      if (n <= 0)
+      {
+         ::close(fd);
+         return false;
+      }
+      p += n;
+      left -= n;
+   }
+   return (::close(fd) == 0);
+}
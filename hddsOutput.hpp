@@ -0,0 +1,128 @@
+/*  HDDS Output Sink
+ *
+ *  Original version - October 17, 2026.
+ *
+ */
+
+#ifndef SAW_HDDSOUTPUT_DEF
+#define SAW_HDDSOUTPUT_DEF true
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <pthread.h>
+
+class OutputSink : public std::streambuf
+{
+ /* The OutputSink class collects the output of a code writer in memory
+  * and writes it out in one piece when it is closed.  Flushing the
+  * stream, as std::endl does at the end of every line, costs nothing,
+  * so the generated sources go out in a few large writes instead of one
+  * system call per line.  The named file is only replaced if its content
+  * would change, which leaves the time stamp of an unchanged source alone
+  * and keeps make from recompiling it.  A path ending in ".gz" selects
+  * gzip compression, and the path "-" means standard output.
+  *
+  * After startPipeline() the numbers written to stream() are not
+  * formatted by the writer.  They are queued together with the text
+  * around them, in blocks that pass through a bounded ring guarded by a
+  * mutex, and a second thread formats them with the precision, width
+  * and flags the stream had at the time.  The text
+  * that comes out is the same, but the formatting runs alongside the
+  * traversal that produces it.  Numbers written while the stream is
+  * attached to another streambuf are formatted in place as usual.
+  */
+ public:
+   enum Compression
+   {
+      kNone,
+      kGzip
+   };
+
+   OutputSink(const std::string& path = "-");
+   OutputSink(const std::string& path, Compression mode);
+   ~OutputSink();
+
+   std::ostream& stream();		// stream that writes into the sink
+   bool startPipeline();		// format numbers in a second thread
+   bool close();			// write out, false on error
+   bool isUnchanged() const;		// close() left the file untouched
+   const std::string& getPath() const;
+
+   static Compression compressionFor(const std::string& path);
+
+ protected:
+   int overflow(int c);
+   std::streamsize xsputn(const char* s, std::streamsize n);
+   int sync();
+
+ private:
+   friend class DeferredNumPut;
+
+   std::string fPath;			// output file, or "-" for stdout
+   Compression fMode;			// compression of the output file
+   std::string fData;			// everything written so far,
+					// formatted
+   bool fClosed;			// close() has been called
+   bool fUnchanged;			// content on disk was already current
+   std::ostream fStream;
+
+   struct Number
+   {
+      size_t offset;			// position in the text of the block
+      char type;			// 'l' long, 'u' unsigned long, 'd' double
+      long lvalue;
+      unsigned long uvalue;
+      double dvalue;
+      std::ios_base::fmtflags flags;	// stream state at the insertion
+      std::streamsize precision;
+      std::streamsize width;
+      char fill;
+   };
+
+   struct Block
+   {
+      std::string text;			// text between the numbers
+      std::vector<Number> numbers;	// numbers in order of offset
+   };
+
+   enum { kRingSize = 16 };		// blocks in flight
+   Block fRing[kRingSize];
+   unsigned int fHead;			// blocks published by the writer
+   unsigned int fTail;			// blocks consumed by the formatter
+   bool fDone;				// last block has been published
+   bool fPipelined;			// startPipeline() succeeded
+   pthread_t fFormatter;
+   pthread_mutex_t fRingLock;		// guards fHead, fTail and fDone
+   pthread_cond_t fRingFilled;		// fHead advanced or fDone set
+   pthread_cond_t fRingEmptied;		// fTail advanced
+
+   void append(const char* s, size_t n);
+   void defer(Number& num, std::ios_base& str, char fill);
+   void publish();			// hand the current block over
+   void drain();			// format queued blocks into fData
+   static void* formatter(void* sink);
+
+   bool matchesFile() const;		// fData equals current file content
+   bool writeFile(const std::string& path) const;
+
+   OutputSink(const OutputSink&);
+   void operator=(const OutputSink&);
+};
+
+inline std::ostream& OutputSink::stream()
+{
+   return fStream;
+}
+
+inline bool OutputSink::isUnchanged() const
+{
+   return fUnchanged;
+}
+
+inline const std::string& OutputSink::getPath() const
+{
+   return fPath;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ *  hddsRootWriter :   code writer classes for the hdds-root and hdds-root_h
+ *                   utilities that write out a ROOT macro, or a header file
+ *                   for the DRootGeom class, to instantiate the geometry
+ *                   within ROOT.
+ *
+ *  Class definition
+ *  Split out of hdds-root.cpp and hdds-root_h.cpp, October 17, 2026.
+ *  For the revision history of the writers see those files.
+ */
+
+#ifndef SAW_HDDSROOTWRITER_DEF
+#define SAW_HDDSROOTWRITER_DEF true
+
+#include <string>
+
+#include <xercesc/dom/DOM.hpp>
+
+using namespace xercesc;
+
+#include "XString.hpp"
+#include "hddsCommon.hpp"
+
+class RootMacroWriter : public CodeWriter
+{
+ public:
+   RootMacroWriter(const std::string& macroname = "hddsroot");
+   static std::string macroName(const XString& xmlFile); // name for xmlFile
+   void createHeader();
+   void createTrailer();
+   int createMaterial(DOMElement* el);  // generate code for materials
+   int createSolid(DOMElement* el,
+                   Refsys& ref);    	// generate code for solids
+   int createRotation(Refsys& ref);     // generate code for rotations
+   int createVolume(DOMElement* el,
+                    Refsys& ref);   	// generate code for placement
+   int createDivision(XString& divStr,
+                      Refsys& ref);	// generate code for divisions
+   void createUtilityFunctions(DOMElement* el,
+                  const XString& ident); // generate utility functions
+
+ protected:
+   std::string fMacroName;		// name of the generated macro
+   int fFirstVolumePlacement;		// SetTopVolume already written
+};
+
+class RootHeaderWriter : public RootMacroWriter
+{
+ /* The RootHeaderWriter class writes the same geometry as RootMacroWriter
+  * but wraps it in a function that returns the TGeoManager, for use as
+  * a header file by the DRootGeom class.
+  */
+ public:
+   RootHeaderWriter() {};
+   void createHeader();
+   void createTrailer();
+   void createUtilityFunctions(DOMElement* el,
+                  const XString& ident); // generate utility functions
+};
+
+#endif